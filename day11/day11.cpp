@@ -1,125 +1,204 @@
-#include <unordered_set>
+#include <numeric>
+#include <optional>
 #include "aoc_library.hpp"
 
 namespace ranges = std::ranges;
 
-template <size_t SIZE>
+struct StepBatch
+{
+    uint64_t total_flashes = 0;
+    std::optional<uint64_t> first_synchronized;
+    std::vector<uint32_t> flashes_per_step;
+};
+
 class Grid
 {
 public:
     Grid(const std::vector<std::string> &input)
+        : height_(input.size()),
+          width_(input.empty() ? 0 : input.front().size()),
+          stride_(width_ + 2),
+          energy_(stride_ * (height_ + 2), 0),
+          border_((energy_.size() + 63) / 64, 0),
+          queue_(width_ * height_)
     {
-        for (int y = 0; const auto &line : input)
+        for (uint64_t y = 0; const auto &line : input)
         {
-            for (int x = 0; const auto c : line)
+            assert(line.size() == width_);
+            for (uint64_t x = 0; const auto c : line)
             {
-                grid_[y * SIZE + x++] = c - '0';
+                energy_[index(x++, y)] = c - '0';
             }
             y++;
         }
-        original_grid_ = grid_;
+        for (uint64_t i = 0; i < energy_.size(); i++)
+        {
+            const uint64_t x = i % stride_;
+            const uint64_t y = i / stride_;
+            if (x == 0 || x == stride_ - 1 || y == 0 || y == height_ + 1)
+            {
+                border_[i / 64] |= 1ul << (i % 64);
+            }
+        }
+        flashed_ = border_;
+        const int64_t s = stride_;
+        neighbours_ = {-s - 1, -s, -s + 1, -1, 1, s - 1, s, s + 1};
+        original_energy_ = energy_;
     }
 
     uint64_t part1(uint64_t steps)
     {
         reset();
-        uint64_t sum = 0;
-        for (uint64_t i = 0; i < steps; i++)
-        {
-            sum += flash_count();
-        }
-        return sum;
+        return run(steps).total_flashes;
     }
 
     uint64_t part2()
     {
         reset();
         uint64_t step = 1;
-        while (flash_count() != SIZE * SIZE)
+        while (flash_count() != width_ * height_)
         {
             step++;
         }
         return step;
     }
 
-private:
+    // Runs steps from the current state, continuing where the previous batch stopped.
+    StepBatch run(uint64_t steps, bool record_steps = false)
+    {
+        StepBatch batch;
+        if (record_steps)
+        {
+            batch.flashes_per_step.reserve(steps);
+        }
+        for (uint64_t i = 0; i < steps; i++)
+        {
+            const auto flashes = flash_count();
+            steps_taken_++;
+            batch.total_flashes += flashes;
+            if (!batch.first_synchronized && flashes == width_ * height_)
+            {
+                batch.first_synchronized = steps_taken_;
+            }
+            if (record_steps)
+            {
+                batch.flashes_per_step.push_back(flashes);
+            }
+        }
+        return batch;
+    }
+
     void reset()
     {
-        grid_ = original_grid_;
+        energy_ = original_energy_;
+        steps_taken_ = 0;
     }
 
-    void increase_energy()
+private:
+    uint64_t index(uint64_t x, uint64_t y) const
+    {
+        return (y + 1) * stride_ + x + 1;
+    }
+
+    bool flashed(uint64_t i) const
     {
-        ranges::for_each(grid_, [](auto &v)
-                         { v++; });
+        return flashed_[i / 64] & (1ul << (i % 64));
     }
 
-    void iterate_flashes()
+    void flash(uint64_t i, uint64_t &tail)
+    {
+        flashed_[i / 64] |= 1ul << (i % 64);
+        queue_[tail++] = i;
+    }
+
+    void increase_energy()
     {
-        visit_.clear();
-        for (unsigned int i = 0; i < grid_.size(); i++)
+        for (uint64_t y = 0; y < height_; y++)
         {
-            if (grid_[i] > 9)
+            uint8_t *row = &energy_[index(0, y)];
+            for (uint64_t x = 0; x < width_; x++)
             {
-                visit_.push_back(i);
+                row[x]++;
             }
         }
+    }
 
-        const auto not_flashed = [this](const uint64_t v)
-        { return !flashed_.contains(v); };
-
-        while (!visit_.empty())
+    void reset_flashed()
+    {
+        for (uint64_t y = 0; y < height_; y++)
         {
-            const auto visiting = visit_;
-            visit_.clear();
-            for (const auto i : visiting | ranges::views::filter(not_flashed))
+            uint8_t *row = &energy_[index(0, y)];
+            for (uint64_t x = 0; x < width_; x++)
             {
-                flashed_.insert(i);
-                for (const auto sur : surrounding_i(i))
-                {
-                    if (++grid_[sur] > 9)
-                    {
-                        visit_.push_back(sur);
-                    }
-                }
+                row[x] = row[x] > 9 ? 0 : row[x];
             }
         }
-
-        ranges::for_each(flashed_, [this](auto &i)
-                         { grid_[i] = 0; });
+        ranges::copy(border_, flashed_.begin());
     }
 
-    std::vector<uint64_t> surrounding_i(uint64_t i) const
+    uint64_t iterate_flashes()
     {
-        std::vector<uint64_t> res = {i + SIZE, i - SIZE};
-        if ((i + 1) % 10 != 0)
+        uint64_t tail = 0;
+        for (uint64_t y = 0; y < height_; y++)
         {
-            res.insert(res.end(), {i + 1, i + SIZE + 1, i - SIZE + 1});
+            for (uint64_t i = index(0, y); i < index(width_, y); i++)
+            {
+                if (energy_[i] > 9)
+                {
+                    flash(i, tail);
+                }
+            }
         }
-        if (i % 10 != 0)
+
+        for (uint64_t head = 0; head < tail; head++)
         {
-            res.insert(res.end(), {i - 1, i - SIZE - 1, i + SIZE - 1});
+            const uint64_t i = queue_[head];
+            for (const auto offset : neighbours_)
+            {
+                const uint64_t sur = i + offset;
+                if (!flashed(sur) && ++energy_[sur] > 9)
+                {
+                    flash(sur, tail);
+                }
+            }
         }
-        const auto [f, l] = ranges::remove_if(res, [this](const auto ind)
-                                              { return ind >= grid_.size(); });
-        res.erase(f, l);
-        return res;
+        return tail;
     }
 
     uint64_t flash_count()
     {
-        flashed_.clear();
         increase_energy();
-        iterate_flashes();
-        return flashed_.size();
+        const auto flashes = iterate_flashes();
+        reset_flashed();
+        return flashes;
     }
 
-    std::vector<uint64_t> visit_;
-    std::unordered_set<uint64_t> flashed_;
-    std::array<uint64_t, SIZE * SIZE> grid_;
-    std::array<uint64_t, SIZE * SIZE> original_grid_;
+    uint64_t height_;
+    uint64_t width_;
+    uint64_t stride_;
+    uint64_t steps_taken_ = 0;
+    std::vector<uint8_t> energy_;
+    std::vector<uint8_t> original_energy_;
+    std::vector<uint64_t> border_;
+    std::vector<uint64_t> flashed_;
+    std::vector<uint32_t> queue_;
+    std::array<int64_t, 8> neighbours_;
 };
 
+std::vector<std::string> generate_grid(uint64_t width, uint64_t height, uint64_t seed)
+{
+    std::vector<std::string> res(height, std::string(width, '0'));
+    for (auto &line : res)
+    {
+        for (auto &c : line)
+        {
+            seed = seed * 6364136223846793005ul + 1442695040888963407ul;
+            c = '0' + (seed >> 33) % 10;
+        }
+    }
+    return res;
+}
+
 int main()
 {
     const aoc::StopWatch stop_watch;
@@ -136,13 +215,52 @@ int main()
             "4846848554",
             "5283751526"};
 
-        Grid<10> test_grid(test);
+        Grid test_grid(test);
         aoc::assert_equal(test_grid.part1(100), 1656ul);
         aoc::assert_equal(test_grid.part2(), 195ul);
+
+        test_grid.reset();
+        const auto batch = test_grid.run(200, true);
+        aoc::assert_equal(batch.flashes_per_step.size(), 200ul);
+        aoc::assert_equal(std::accumulate(batch.flashes_per_step.begin(), batch.flashes_per_step.begin() + 10, 0ul), 204ul);
+        aoc::assert_equal(*batch.first_synchronized, 195ul);
     }
-    Grid<10> grid(aoc::get_lines("input.txt"));
+    {
+        const std::vector<std::string> small = {
+            "11111",
+            "19991",
+            "19191",
+            "19991",
+            "11111"};
+        Grid small_grid(small);
+        const auto batch = small_grid.run(2, true);
+        aoc::assert_equal(batch.flashes_per_step[0], 9u);
+        aoc::assert_equal(batch.flashes_per_step[1], 0u);
+    }
+    {
+        const std::vector<std::string> wide = {
+            "1111111",
+            "1999991",
+            "1111111"};
+        Grid wide_grid(wide);
+        aoc::assert_equal(wide_grid.part1(1), 5ul);
+    }
+    Grid grid(aoc::get_lines("input.txt"));
     aoc::assert_equal(grid.part1(100), 1739ul);
     aoc::assert_equal(grid.part2(), 324ul);
+    {
+        const aoc::StopWatch batch_watch;
+        grid.reset();
+        const auto batch = grid.run(1000000);
+        aoc::assert_equal(*batch.first_synchronized, 324ul);
+        aoc::print("1e6 steps 10x10, flashes: ", batch.total_flashes);
+    }
+    {
+        const aoc::StopWatch large_watch;
+        Grid large(generate_grid(500, 300, 11));
+        const auto batch = large.run(100);
+        aoc::print("100 steps 500x300, flashes: ", batch.total_flashes);
+    }
 
     return 0;
 }
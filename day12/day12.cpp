@@ -1,9 +1,9 @@
-#include <unordered_set>
+#include <bit>
 #include "aoc_library.hpp"
 
 namespace ranges = std::ranges;
 
-typedef std::unordered_map<std::string, std::vector<std::string>> NodeConnections;
+typedef unsigned __int128 PathCount;
 
 inline constexpr char start[] = "start";
 inline constexpr char end[] = "end";
@@ -14,99 +14,153 @@ inline bool small(const std::string &name)
                           { return !isupper(c); });
 };
 
-NodeConnections parse(const std::vector<std::string> &input)
+std::string to_string(PathCount count)
 {
-    std::unordered_map<std::string, std::vector<std::string>> nodes;
-    for (const auto &line : input)
+    std::string res;
+    do
     {
-        const auto ns = aoc::split(line, "-");
-        for (int i = 0; const auto &el : ns)
-        {
-            if (!nodes.contains(el))
-            {
-                nodes.insert({el, {}});
-            }
-            auto &neighbours = nodes.at(el);
-            const std::string &connection = ns[((i++) + 1) % 2];
-            if (ranges::find(neighbours, connection) == neighbours.end())
-            {
-                neighbours.push_back(connection);
-            }
-        }
-    }
-    return nodes;
+        res.push_back('0' + static_cast<char>(count % 10));
+        count /= 10;
+    } while (count != 0);
+    ranges::reverse(res);
+    return res;
 }
 
-class Path
+// Caves are interned to ids with the small caves first, so a set of visited
+// small caves is a bitmask over the low ids. The memo is a dense table over
+// every (node, visited, twice) state while that fits in dense_limit entries,
+// and a hash map of the reachable states beyond that.
+class CaveGraph
 {
 public:
-    Path(const std::string &last_node_name, const std::shared_ptr<Path> &tail, bool part2 = false)
-        : last_node_name_(last_node_name),
-          tail_(tail)
+    CaveGraph(const std::vector<std::string> &input)
     {
-        if (!part2 ||
-            (tail && tail->visited_small_twice_) ||
-            (small(last_node_name) && contains(last_node_name)))
+        std::vector<std::array<std::string, 2>> edges;
+        std::vector<std::string> names;
+        for (const auto &line : input)
         {
-            visited_small_twice_ = true;
+            const auto ns = aoc::split(line, "-");
+            edges.push_back({ns[0], ns[1]});
+            names.insert(names.end(), ns.begin(), ns.end());
         }
-    }
+        ranges::sort(names, [](const auto &a, const auto &b)
+                     { return std::make_pair(!small(a), a) < std::make_pair(!small(b), b); });
+        const auto [f, l] = ranges::unique(names);
+        names.erase(f, l);
+        assert(names.size() <= 64);
+
+        std::unordered_map<std::string, uint64_t> ids;
+        for (uint64_t id = 0; const auto &name : names)
+        {
+            ids[name] = id++;
+        }
+        small_count_ = ranges::count_if(names, small);
+        start_ = ids.at(start);
+        end_ = ids.at(end);
 
-    bool ok_to_add(const std::string &node) const
-    {
-        if (node == start)
+        adjacent_.assign(names.size(), 0);
+        for (const auto &[a, b] : edges)
         {
-            return false;
+            adjacent_[ids.at(a)] |= 1ul << ids.at(b);
+            adjacent_[ids.at(b)] |= 1ul << ids.at(a);
         }
-        if (small(node) && contains(node))
+        for (auto &adjacent : adjacent_)
         {
-            return !visited_small_twice_;
+            adjacent &= ~(1ul << start_);
         }
-        return true;
     }
 
-    std::string last_node_name_;
+    PathCount count_paths(bool part2)
+    {
+        const bool dense = small_count_ < 40 && (adjacent_.size() << (small_count_ + 1)) <= dense_limit;
+        dense_memo_.assign(dense ? adjacent_.size() << (small_count_ + 1) : 0, unknown);
+        hashed_memo_.clear();
+        return count(start_, 1ul << start_, !part2);
+    }
 
 private:
-    bool contains(const std::string &name) const
+    static constexpr PathCount unknown = ~PathCount(0);
+    static constexpr uint64_t dense_limit = 1 << 22;
+
+    struct state_hash
+    {
+        uint64_t operator()(const std::pair<uint64_t, uint64_t> &state) const
+        {
+            return (state.first * 0x9e3779b97f4a7c15ul) ^ state.second;
+        }
+    };
+
+    PathCount count(uint64_t node, uint64_t visited, bool visited_small_twice)
     {
-        if (!tail_)
+        if (node == end_)
         {
-            return false;
+            return 1;
         }
-        if (tail_->last_node_name_ == name)
+        const auto state = std::make_pair(visited, (node << 1) | visited_small_twice);
+        const uint64_t index = (((visited << 1) | visited_small_twice) * adjacent_.size()) + node;
+        if (!dense_memo_.empty())
         {
-            return true;
+            if (dense_memo_[index] != unknown)
+            {
+                return dense_memo_[index];
+            }
+        }
+        else if (const auto found = hashed_memo_.find(state); found != hashed_memo_.end())
+        {
+            return found->second;
         }
-        return tail_->contains(name);
+
+        PathCount res = 0;
+        for (uint64_t next = adjacent_[node]; next != 0; next &= next - 1)
+        {
+            const uint64_t id = std::countr_zero(next);
+            if (id >= small_count_)
+            {
+                res += count(id, visited, visited_small_twice);
+            }
+            else if (!(visited & (1ul << id)))
+            {
+                res += count(id, visited | (1ul << id), visited_small_twice);
+            }
+            else if (!visited_small_twice)
+            {
+                res += count(id, visited, true);
+            }
+        }
+        if (!dense_memo_.empty())
+        {
+            dense_memo_[index] = res;
+        }
+        else
+        {
+            hashed_memo_.emplace(state, res);
+        }
+        return res;
     }
 
-    bool visited_small_twice_ = false;
-    std::shared_ptr<Path> tail_;
+    uint64_t small_count_;
+    uint64_t start_;
+    uint64_t end_;
+    std::vector<uint64_t> adjacent_;
+    std::vector<PathCount> dense_memo_;
+    std::unordered_map<std::pair<uint64_t, uint64_t>, PathCount, state_hash> hashed_memo_;
 };
 
-uint64_t find_all_paths(const NodeConnections &map, bool part2)
+std::vector<std::string> generate_hubs(uint64_t big_caves, uint64_t small_caves)
 {
-    std::vector<std::shared_ptr<Path>> searching = {std::make_shared<Path>(start, nullptr, part2)};
-    uint64_t complete = 0;
-    while (!searching.empty())
+    assert(big_caves <= 26);
+    std::vector<std::string> res;
+    for (uint64_t b = 0; b < big_caves; b++)
     {
-        const auto tail = searching.back();
-        searching.pop_back();
-        for (const auto &next : map.at(tail->last_node_name_))
+        const auto big = std::string("B") += static_cast<char>('A' + b);
+        res.push_back(std::string(start) + "-" + big);
+        res.push_back(big + "-" + end);
+        for (uint64_t s = 0; s < small_caves; s++)
         {
-            if (next == end)
-            {
-                complete++;
-                continue;
-            }
-            if (tail->ok_to_add(next))
-            {
-                searching.push_back(std::make_shared<Path>(next, tail, part2));
-            }
+            res.push_back(big + "-" + (std::string("s") += std::to_string(s)));
         }
     }
-    return complete;
+    return res;
 }
 
 int main()
@@ -120,15 +174,39 @@ int main()
                                             "b-d",
                                             "A-end",
                                             "b-end"};
-    const auto parsed = parse(test1);
+    CaveGraph test_graph(test1);
 
-    aoc::assert_equal(find_all_paths(parsed, false), 10ul);
-    aoc::assert_equal(find_all_paths(parsed, true), 36ul);
+    aoc::assert_equal(to_string(test_graph.count_paths(false)), std::string("10"));
+    aoc::assert_equal(to_string(test_graph.count_paths(true)), std::string("36"));
 
-    const auto node_map = parse(aoc::get_lines("input.txt"));
+    const std::vector<std::string> test3 = {"fs-end", "he-DX", "fs-he", "start-DX", "pj-DX", "end-zg",
+                                            "zg-sl", "zg-pj", "pj-he", "RW-he", "fs-DX", "pj-RW",
+                                            "zg-RW", "start-pj", "he-WI", "zg-he", "pj-fs", "start-RW"};
+    CaveGraph test_graph3(test3);
+    aoc::assert_equal(to_string(test_graph3.count_paths(false)), std::string("226"));
+    aoc::assert_equal(to_string(test_graph3.count_paths(true)), std::string("3509"));
 
-    aoc::assert_equal(find_all_paths(node_map, false), 3292ul);
-    aoc::assert_equal(find_all_paths(node_map, true), 89592ul);
+    CaveGraph graph(aoc::get_lines("input.txt"));
+
+    aoc::assert_equal(to_string(graph.count_paths(false)), std::string("3292"));
+    aoc::assert_equal(to_string(graph.count_paths(true)), std::string("89592"));
+
+    {
+        std::vector<std::string> chain = {"start-c0", "c39-end"};
+        for (uint64_t i = 0; i + 1 < 40; i++)
+        {
+            chain.push_back((std::string("c") += std::to_string(i)) + "-" + (std::string("c") += std::to_string(i + 1)));
+        }
+        CaveGraph chain_graph(chain);
+        aoc::assert_equal(to_string(chain_graph.count_paths(false)), std::string("1"));
+        aoc::assert_equal(to_string(chain_graph.count_paths(true)), std::string("1"));
+    }
+    {
+        const aoc::StopWatch hubs_watch;
+        CaveGraph hubs(generate_hubs(10, 14));
+        aoc::assert_equal(to_string(hubs.count_paths(false)), std::string("96346912121770152264423410"));
+        aoc::assert_equal(to_string(hubs.count_paths(true)), std::string("99916565215881736405820297410"));
+    }
 
     return 0;
 }
@@ -1,37 +1,29 @@
 
-#include <unordered_set>
+#include <atomic>
+#include <bit>
+#include <numeric>
+#include <thread>
 #include "aoc_library.hpp"
 
 namespace ranges = std::ranges;
 
 typedef std::pair<uint64_t, uint64_t> Point;
 
-struct point_hash
-{
-    std::size_t operator()(const Point &pair) const
-    {
-        const auto hash_fun = std::hash<uint64_t>();
-        return hash_fun(pair.first) ^ hash_fun(pair.second);
-    }
-};
-
-typedef std::unordered_set<Point, point_hash> PointMap;
-
 struct FoldInstruction
 {
     char direction_;
     uint64_t position_;
 };
 
-std::pair<PointMap, std::vector<FoldInstruction>>
+std::pair<std::vector<Point>, std::vector<FoldInstruction>>
 parse(const std::vector<std::string> &input)
 {
     const auto separator = ranges::find(input, "");
-    PointMap points;
+    std::vector<Point> points;
     ranges::for_each(input.begin(), separator, [&points](const auto &line)
                      {
                          const auto splitted = aoc::split(line, ",");
-                         points.insert({std::stoull(splitted.at(0)), std::stoull(splitted.at(1))});
+                         points.push_back({std::stoull(splitted.at(0)), std::stoull(splitted.at(1))});
                      });
 
     const std::regex regex("fold along (\\w)=(\\d+)");
@@ -47,66 +39,213 @@ parse(const std::vector<std::string> &input)
     return {points, instructions};
 }
 
-Point fold_point(const Point &point, const FoldInstruction &instruction)
+struct Paper
 {
-    auto res = point;
-    if (instruction.direction_ == 'x' &&
-        point.first > instruction.position_)
+    uint64_t visible() const
     {
-        res.first = instruction.position_ * 2 - point.first;
+        return std::accumulate(bits_.begin(), bits_.end(), 0ul, [](const auto sum, const auto word)
+                               { return sum + std::popcount(word); });
     }
-    else if (instruction.direction_ == 'y' &&
-             point.second > instruction.position_)
+
+    bool dot(uint64_t x, uint64_t y) const
     {
-        res.second = instruction.position_ * 2 - point.second;
+        const auto i = y * width_ + x;
+        return bits_[i / 64] & (1ul << (i % 64));
     }
-    return res;
-}
 
-PointMap visible_dots(const PointMap &og_points, const std::vector<FoldInstruction> &ins)
+    uint64_t width_;
+    uint64_t height_;
+    std::vector<uint64_t> bits_;
+};
+
+// Composes every fold along one axis into a single lookup table from original
+// to final coordinate, so each dot is moved once regardless of fold count.
+class FoldEngine
 {
-    auto points = og_points;
-    PointMap after_ins = {};
+public:
+    FoldEngine(const std::vector<FoldInstruction> &ins, uint64_t width, uint64_t height)
+        : x_map_(compose(ins, 'x', width)),
+          y_map_(compose(ins, 'y', height)),
+          width_(final_size(ins, 'x', width)),
+          height_(final_size(ins, 'y', height))
+    {
+    }
+
+    Paper apply(const std::vector<Point> &dots, unsigned threads = 1) const
+    {
+        Paper paper = {width_, height_, std::vector<uint64_t>((width_ * height_ + 63) / 64, 0)};
+        const auto fold_range = [&](uint64_t first, uint64_t last)
+        {
+            for (uint64_t i = first; i < last; i++)
+            {
+                const auto &[x, y] = dots[i];
+                if (x >= x_map_.size() || y >= y_map_.size() ||
+                    x_map_[x] == removed || y_map_[y] == removed)
+                {
+                    continue;
+                }
+                const auto bit = y_map_[y] * width_ + x_map_[x];
+                std::atomic_ref<uint64_t>(paper.bits_[bit / 64]).fetch_or(1ul << (bit % 64), std::memory_order_relaxed);
+            }
+        };
+
+        if (threads <= 1)
+        {
+            fold_range(0, dots.size());
+            return paper;
+        }
+        std::vector<std::thread> workers;
+        const uint64_t chunk = (dots.size() + threads - 1) / threads;
+        for (uint64_t first = 0; first < dots.size(); first += chunk)
+        {
+            workers.emplace_back(fold_range, first, std::min(first + chunk, dots.size()));
+        }
+        ranges::for_each(workers, [](auto &worker)
+                         { worker.join(); });
+        return paper;
+    }
+
+private:
+    static constexpr uint64_t removed = std::numeric_limits<uint64_t>::max();
 
-    for (const auto &instruction : ins)
+    static std::vector<uint64_t> sizes(const std::vector<FoldInstruction> &ins, char axis, uint64_t size)
     {
-        after_ins.clear();
-        for (auto &point : points)
+        std::vector<uint64_t> res = {size};
+        for (const auto &instruction : ins)
         {
-            after_ins.insert(fold_point(point, instruction));
+            if (instruction.direction_ == axis && instruction.position_ < res.back())
+            {
+                assert(res.back() - 1 <= instruction.position_ * 2);
+                res.push_back(instruction.position_);
+            }
         }
-        points = after_ins;
+        return res;
     }
-    return points;
-}
 
-void print_visible_dots(const PointMap &points)
+    static uint64_t final_size(const std::vector<FoldInstruction> &ins, char axis, uint64_t size)
+    {
+        return sizes(ins, axis, size).back();
+    }
+
+    // Built back to front: each fold only remaps the coordinates of the
+    // paper before it, so the total work is the sum of the paper sizes.
+    static std::vector<uint64_t> compose(const std::vector<FoldInstruction> &ins, char axis, uint64_t size)
+    {
+        const auto before = sizes(ins, axis, size);
+        std::vector<uint64_t> map(before.back());
+        std::iota(map.begin(), map.end(), 0ul);
+
+        std::vector<uint64_t> tmp;
+        for (auto i = before.size() - 1; i > 0; i--)
+        {
+            const auto position = before[i];
+            tmp.resize(before[i - 1]);
+            for (uint64_t v = 0; v < tmp.size(); v++)
+            {
+                if (v == position)
+                {
+                    tmp[v] = removed;
+                }
+                else
+                {
+                    tmp[v] = map[v < position ? v : position * 2 - v];
+                }
+            }
+            std::swap(map, tmp);
+        }
+        return map;
+    }
+
+    std::vector<uint64_t> x_map_;
+    std::vector<uint64_t> y_map_;
+    uint64_t width_;
+    uint64_t height_;
+};
+
+Paper visible_dots(const std::vector<Point> &points, const std::vector<FoldInstruction> &ins, unsigned threads = 1)
 {
     Point max = {0, 0};
     for (const auto &point : points)
     {
         max = {std::max(point.first, max.first), std::max(point.second, max.second)};
     }
+    const FoldEngine engine(ins, max.first + 1, max.second + 1);
+    return engine.apply(points, threads);
+}
+
+void print_visible_dots(const Paper &paper)
+{
+    Point max = {0, 0};
+    for (uint64_t y = 0; y < paper.height_; y++)
+    {
+        for (uint64_t x = 0; x < paper.width_; x++)
+        {
+            if (paper.dot(x, y))
+            {
+                max = {std::max(x, max.first), std::max(y, max.second)};
+            }
+        }
+    }
     auto pretty = std::vector<std::vector<char>>(max.second + 1, std::vector<char>(max.first + 1, ' '));
-    for (const auto &point : points)
+    for (uint64_t y = 0; y <= max.second; y++)
     {
-        pretty.at(point.second).at(point.first) = '#';
+        for (uint64_t x = 0; x <= max.first; x++)
+        {
+            if (paper.dot(x, y))
+            {
+                pretty.at(y).at(x) = '#';
+            }
+        }
     }
     aoc::print(pretty);
 }
 
+std::pair<std::vector<Point>, std::vector<FoldInstruction>>
+generate(uint64_t dot_count, uint64_t folds_per_axis, uint64_t seed)
+{
+    const uint64_t size = (2ul << folds_per_axis) * 8 - 1;
+    std::vector<FoldInstruction> instructions;
+    for (uint64_t w = size; instructions.size() < folds_per_axis * 2; w /= 2)
+    {
+        instructions.push_back({'x', w / 2});
+        instructions.push_back({'y', w / 2});
+    }
+    std::vector<Point> points(dot_count);
+    for (auto &point : points)
+    {
+        seed = seed * 6364136223846793005ul + 1442695040888963407ul;
+        point = {(seed >> 16) % size, (seed >> 40) % size};
+    }
+    return {points, instructions};
+}
+
 int main()
 {
     const aoc::StopWatch stop_watch;
     {
         const auto [map, instructions] = parse(aoc::get_lines("test.txt"));
 
-        aoc::assert_equal(visible_dots(map, {instructions[0]}).size(), 17ul);
+        aoc::assert_equal(visible_dots(map, {instructions[0]}).visible(), 17ul);
+        aoc::assert_equal(visible_dots(map, instructions).visible(), 16ul);
+        aoc::assert_equal(visible_dots(map, instructions, 4).visible(), 16ul);
     }
     const auto [map, instructions] = parse(aoc::get_lines("input.txt"));
 
-    aoc::assert_equal(visible_dots(map, {instructions[0]}).size(), 775ul); // part 1
-    print_visible_dots(visible_dots(map, instructions));                   // part 2
+    aoc::assert_equal(visible_dots(map, {instructions[0]}).visible(), 775ul); // part 1
+    print_visible_dots(visible_dots(map, instructions));                      // part 2
+
+    {
+        const auto [dots, folds] = generate(4000000, 12, 13);
+        {
+            const aoc::StopWatch single_watch;
+            aoc::print("generated, single thread: ", visible_dots(dots, folds).visible());
+        }
+        {
+            const aoc::StopWatch parallel_watch;
+            const auto threads = std::max(2u, std::thread::hardware_concurrency());
+            aoc::print("generated, ", threads, " threads: ", visible_dots(dots, folds, threads).visible());
+        }
+    }
 
     return 0;
 }
@@ -2,8 +2,6 @@
 
 namespace ranges = std::ranges;
 
-typedef std::unordered_map<std::string, uint64_t> ElementCount;
-typedef std::unordered_map<std::string, ElementCount> PairToElementCount;
 typedef std::unordered_map<std::string, std::string> InsertRules;
 
 struct Problem
@@ -23,72 +21,188 @@ Problem parse(const std::vector<std::string> &input)
     return {input[0], insert_rules};
 }
 
-inline void update(ElementCount &map, std::pair<std::string, uint64_t> update)
+typedef std::array<uint64_t, 26> ElementCounts;
+
+// Elements are letters mapped to 0..25 and a pair is first * 26 + second.
+// Only pairs made of elements that occur in the polymer or the rules can ever
+// appear, so stepping and the transition matrix are restricted to those.
+class PolymerEngine
 {
-    if (map.contains(update.first))
+public:
+    static constexpr uint64_t pair_count = 26 * 26;
+
+    PolymerEngine(const Problem &problem)
+        : last_(problem.polymer_.back() - 'A')
     {
-        map.at(update.first) += update.second;
+        std::array<bool, 26> present = {};
+        for (const auto c : problem.polymer_)
+        {
+            present[c - 'A'] = true;
+        }
+        for (uint64_t i = 0; i < problem.polymer_.size() - 1; i++)
+        {
+            initial_[pair(problem.polymer_[i], problem.polymer_[i + 1])]++;
+        }
+        for (uint64_t p = 0; p < pair_count; p++)
+        {
+            transitions_[p] = {p, none};
+        }
+        for (const auto &[from, to] : problem.pair_insert_rules_)
+        {
+            present[from[0] - 'A'] = present[from[1] - 'A'] = present[to[0] - 'A'] = true;
+            transitions_[pair(from[0], from[1])] = {pair(from[0], to[0]), pair(to[0], from[1])};
+        }
+        for (uint64_t p = 0; p < pair_count; p++)
+        {
+            if (present[p / 26] && present[p % 26])
+            {
+                active_.push_back(p);
+            }
+        }
     }
-    else
+
+    ElementCounts step(uint64_t steps) const
     {
-        map.insert(update);
+        auto counts = initial_;
+        std::array<uint64_t, pair_count> next;
+        for (uint64_t i = 0; i < steps; i++)
+        {
+            next.fill(0);
+            for (const auto p : active_)
+            {
+                const auto [left, right] = transitions_[p];
+                next[left] += counts[p];
+                if (right != none)
+                {
+                    next[right] += counts[p];
+                }
+            }
+            std::swap(counts, next);
+        }
+        return elements(counts);
     }
-}
 
-inline void update(ElementCount &count1, const ElementCount &count2)
-{
-    for (const auto &el : count2)
+    // Same result as step() in O(k^3 log steps) for k active pairs.
+    ElementCounts power(uint64_t steps) const
     {
-        update(count1, el);
+        const auto k = active_.size();
+        std::array<uint64_t, pair_count> column = {};
+        for (uint64_t i = 0; i < k; i++)
+        {
+            column[active_[i]] = i;
+        }
+
+        Matrix matrix(k, std::vector<uint64_t>(k, 0));
+        for (uint64_t i = 0; i < k; i++)
+        {
+            const auto [left, right] = transitions_[active_[i]];
+            matrix[column[left]][i]++;
+            if (right != none)
+            {
+                matrix[column[right]][i]++;
+            }
+        }
+
+        std::vector<uint64_t> vector(k);
+        for (uint64_t i = 0; i < k; i++)
+        {
+            vector[i] = initial_[active_[i]];
+        }
+        for (; steps != 0; steps >>= 1)
+        {
+            if (steps & 1)
+            {
+                vector = multiply(matrix, vector);
+            }
+            if (steps > 1)
+            {
+                matrix = multiply(matrix, matrix);
+            }
+        }
+
+        std::array<uint64_t, pair_count> counts = {};
+        for (uint64_t i = 0; i < k; i++)
+        {
+            counts[active_[i]] = vector[i];
+        }
+        return elements(counts);
     }
-}
 
-PairToElementCount expand(const InsertRules &insert_rules, uint64_t times)
-{
-    PairToElementCount count_map;
-    for (const auto &[pair, element] : insert_rules)
+private:
+    typedef std::vector<std::vector<uint64_t>> Matrix;
+
+    static constexpr uint64_t none = pair_count;
+
+    static uint64_t pair(char first, char second)
     {
-        ElementCount count;
-        update(count, {pair.substr(0, 1), 1});
-        update(count, {element, 1});
-        update(count, {pair.substr(1, 1), 1});
-        count_map.emplace(pair, count);
+        return (first - 'A') * 26 + (second - 'A');
     }
 
-    for (uint64_t i = 1; i < times; i++)
+    static std::vector<uint64_t> multiply(const Matrix &matrix, const std::vector<uint64_t> &vector)
     {
-        auto copy = count_map;
-        for (auto &[pair, element_count] : copy)
+        std::vector<uint64_t> res(vector.size(), 0);
+        for (uint64_t row = 0; row < matrix.size(); row++)
         {
-            const auto to_insert = insert_rules.at(pair);
-            const auto left = pair.substr(0, 1) + to_insert;
-            const auto right = to_insert + pair.substr(1, 1);
+            for (uint64_t col = 0; col < vector.size(); col++)
+            {
+                res[row] += matrix[row][col] * vector[col];
+            }
+        }
+        return res;
+    }
 
-            element_count = count_map.at(left);
-            update(element_count, count_map.at(right));
-            element_count.at(to_insert)--;
+    static Matrix multiply(const Matrix &a, const Matrix &b)
+    {
+        Matrix res(a.size(), std::vector<uint64_t>(a.size(), 0));
+        for (uint64_t row = 0; row < a.size(); row++)
+        {
+            for (uint64_t mid = 0; mid < a.size(); mid++)
+            {
+                const auto factor = a[row][mid];
+                if (factor == 0)
+                {
+                    continue;
+                }
+                for (uint64_t col = 0; col < a.size(); col++)
+                {
+                    res[row][col] += factor * b[mid][col];
+                }
+            }
         }
-        count_map = copy;
+        return res;
     }
-    return count_map;
-}
 
-uint64_t solve(const PairToElementCount &lookup, const std::string &polymer)
-{
-    ElementCount resulting = {{polymer.substr(0, 1), 1}};
-    for (uint64_t i = 0; i < polymer.size() - 1; i++)
+    // Every element is the first of exactly one pair, except the last one.
+    ElementCounts elements(const std::array<uint64_t, pair_count> &counts) const
     {
-        const auto pair = polymer.substr(i, 2);
-        update(resulting, lookup.at(pair));
-        resulting.at(pair.substr(0, 1))--;
+        ElementCounts res = {};
+        for (const auto p : active_)
+        {
+            res[p / 26] += counts[p];
+        }
+        res[last_]++;
+        return res;
     }
 
+    uint64_t last_;
+    std::array<uint64_t, pair_count> initial_ = {};
+    std::array<std::array<uint64_t, 2>, pair_count> transitions_;
+    std::vector<uint64_t> active_;
+};
+
+// Counts wrap modulo 2^64 once they outgrow it, so this is only meaningful
+// while every count fits.
+uint64_t solve(const ElementCounts &counts)
+{
     uint64_t min = std::numeric_limits<uint64_t>::max();
     uint64_t max = 0;
-    for (const auto &[c, nr] : resulting)
+    for (const auto nr : counts)
     {
-        min = std::min(min, nr);
-        max = std::max(max, nr);
+        if (nr != 0)
+        {
+            min = std::min(min, nr);
+            max = std::max(max, nr);
+        }
     }
     return max - min;
 }
@@ -116,16 +230,29 @@ int main()
                                                      "CC -> N",
                                                      "CN -> C"};
 
-        const auto [polymer, pair_lookup] = parse(test_input);
-        aoc::assert_equal(solve(expand(pair_lookup, 10), polymer), 1588ul);          // test part 1
-        aoc::assert_equal(solve(expand(pair_lookup, 40), polymer), 2188189693529ul); // test part 2
+        const PolymerEngine engine(parse(test_input));
+        aoc::assert_equal(solve(engine.step(10)), 1588ul);          // test part 1
+        aoc::assert_equal(solve(engine.step(40)), 2188189693529ul); // test part 2
+        aoc::assert_equal(solve(engine.power(10)), 1588ul);
+        aoc::assert_equal(solve(engine.power(40)), 2188189693529ul);
     }
 
     const auto lines = aoc::get_lines("input.txt");
-    const auto [polymer, pair_lookup] = parse(lines);
+    const PolymerEngine engine(parse(lines));
+
+    aoc::assert_equal(solve(engine.step(10)), 3247ul);          // part 1
+    aoc::assert_equal(solve(engine.step(40)), 4110568157153ul); // part 2
+    aoc::assert_equal(solve(engine.power(40)), 4110568157153ul);
 
-    aoc::assert_equal(solve(expand(pair_lookup, 10), polymer), 3247ul);          // part 1
-    aoc::assert_equal(solve(expand(pair_lookup, 40), polymer), 4110568157153ul); // part 2
+    {
+        const aoc::StopWatch step_watch;
+        const auto counts = engine.step(1000000);
+        aoc::assert_equal(counts == engine.power(1000000), true);
+    }
+    {
+        const aoc::StopWatch power_watch;
+        aoc::print("10^18 steps, B count mod 2^64: ", engine.power(1000000000000000000ul)[1]);
+    }
 
     return 0;
 }
@@ -1,134 +1,120 @@
-#include <unordered_set>
-#include <set>
-#include <cmath>
 #include "aoc_library.hpp"
 
 namespace ranges = std::ranges;
 
-typedef std::vector<std::vector<uint64_t>> Grid;
-
-struct Point
+// Risk levels for a tile repeated tiles x tiles times, where every step right
+// or down adds one to the risk, wrapping from 9 back to 1. Only the original
+// tile is stored.
+class RiskMap
 {
-    uint64_t x;
-    uint64_t y;
+public:
+    RiskMap(std::vector<uint8_t> tile, uint64_t tile_width, uint64_t tile_height, uint64_t tiles)
+        : tile_(std::move(tile)),
+          tile_width_(tile_width),
+          tile_height_(tile_height),
+          width_(tile_width * tiles),
+          height_(tile_height * tiles)
+    {
+    }
 
-    bool operator==(const Point &rhs) const
+    uint64_t risk(uint64_t x, uint64_t y) const
     {
-        return x == rhs.x && y == rhs.y;
+        const auto base = tile_[(y % tile_height_) * tile_width_ + x % tile_width_];
+        return (base + x / tile_width_ + y / tile_height_ - 1) % 9 + 1;
     }
+
+    uint64_t width() const { return width_; }
+    uint64_t height() const { return height_; }
+
+private:
+    std::vector<uint8_t> tile_;
+    uint64_t tile_width_;
+    uint64_t tile_height_;
+    uint64_t width_;
+    uint64_t height_;
 };
 
-struct MinPrioPoint
+RiskMap parse(const std::vector<std::string> &input, bool part2 = false)
 {
-    Point point;
-    uint64_t cost;
-
-    auto operator<=>(const MinPrioPoint &rhs) const
+    std::vector<uint8_t> tile;
+    for (const auto &line : input)
     {
-        if (point == rhs.point)
-            return 0;
-        if (cost < rhs.cost)
-            return -1;
-        else if (cost > rhs.cost)
-            return 1;
-        else
+        for (const auto c : line)
         {
-            if (point.x < rhs.point.x)
-                return -1;
-            if (point.x > rhs.point.x)
-                return 1;
-            return point.y < rhs.point.y ? -1 : 1;
+            tile.push_back(c - '0');
         }
     }
+    return RiskMap(std::move(tile), input[0].size(), input.size(), part2 ? 5 : 1);
+}
 
-};
-
-inline std::vector<Point> neighbours(const Grid &grid, const Point &at)
+// Dial's algorithm: with edge weights in 1..9 every tentative distance in the
+// queue lies within 9 of the one being popped, so ten buckets indexed by
+// distance modulo ten replace the priority queue.
+uint64_t dijkstra(const RiskMap &map)
 {
-    std::vector<Point> res = {{at.x - 1, at.y}, {at.x + 1, at.y}, {at.x, at.y - 1}, {at.x, at.y + 1}};
+    constexpr uint64_t bucket_count = 10;
+    const uint64_t width = map.width();
+    const uint64_t end = width * map.height() - 1;
 
-    const auto [f, l] = ranges::remove_if(res, [&grid](const auto p)
-                                          { return p.x >= grid[0].size() || p.y >= grid.size(); });
-    res.erase(f, l);
-    return res;
-}
+    std::vector<uint32_t> distance(end + 1, std::numeric_limits<uint32_t>::max());
+    std::array<std::vector<uint32_t>, bucket_count> buckets;
+    distance[0] = 0;
+    buckets[0].push_back(0);
 
-Grid parse(const std::vector<std::string> &input, bool part2 = false)
-{
-    Grid res;
-    for (const auto &line : input)
+    const auto relax = [&](uint64_t from, uint64_t x, uint64_t y)
     {
-        std::vector<uint64_t> row;
-        for (const auto c : line)
+        const auto to = y * width + x;
+        const auto tentative = distance[from] + map.risk(x, y);
+        if (tentative < distance[to])
         {
-            row.push_back(c - '0');
+            distance[to] = tentative;
+            buckets[tentative % bucket_count].push_back(to);
         }
-        res.push_back(row);
-    }
+    };
 
-    if (part2)
+    for (uint64_t current = 0;; current++)
     {
-        uint64_t orig_row_size = res[0].size();
-        for (uint64_t row_i = 0; row_i < res.size(); row_i++)
+        auto &bucket = buckets[current % bucket_count];
+        // Relaxing never pushes into the bucket being drained, since all
+        // weights are at least one and at most nine.
+        for (uint64_t i = 0; i < bucket.size(); i++)
         {
-            auto &row = res[row_i];
-            for (uint64_t i = orig_row_size; i < orig_row_size * 5; i++)
+            const auto at = bucket[i];
+            if (distance[at] != current)
             {
-                row.push_back(row[i - orig_row_size] % 9 + 1);
+                continue;
             }
-        }
-
-        uint64_t orig_col_size = res.size();
-        for (uint64_t i = orig_col_size; i < orig_col_size * 5; i++)
-        {
-            std::vector<uint64_t> row;
-            for (const auto &nr : res[i - orig_col_size])
+            if (at == end)
             {
-                row.push_back(nr % 9 + 1);
+                return current;
             }
-            res.push_back(row);
+            const auto x = at % width;
+            const auto y = at / width;
+            if (x > 0)
+                relax(at, x - 1, y);
+            if (x + 1 < width)
+                relax(at, x + 1, y);
+            if (y > 0)
+                relax(at, x, y - 1);
+            if (y + 1 < map.height())
+                relax(at, x, y + 1);
         }
+        bucket.clear();
     }
-    return res;
 }
 
-uint64_t dijkstra(const Grid &cost_grid)
+std::vector<std::string> generate(uint64_t size, uint64_t seed)
 {
-    const Point start = {0, 0};
-    const Point end = {cost_grid[0].size() - 1, cost_grid.size() - 1};
-    std::set<MinPrioPoint> open_set = {{.point=start, .cost=0}};
-
-    Grid distance_map = Grid(cost_grid.size(),
-                             std::vector<uint64_t>(cost_grid[0].size(),
-                                                   std::numeric_limits<uint64_t>::max()));
-    distance_map[0][0] = 0;
-
-    MinPrioPoint current;
-    while (true)
+    std::vector<std::string> res(size, std::string(size, '1'));
+    for (auto &line : res)
     {
-        current = *open_set.begin();
-        if (current.point == end)
+        for (auto &c : line)
         {
-            return distance_map[end.y][end.x];
-        }
-        open_set.erase(current);
-        for (const auto &neighbour : neighbours(cost_grid, current.point))
-        {
-            const uint64_t tentative_cost = distance_map[current.point.y][current.point.x] +
-                                      cost_grid[neighbour.y][neighbour.x];
-
-            if (tentative_cost < distance_map[neighbour.y][neighbour.x])
-            {
-                distance_map[neighbour.y][neighbour.x] = tentative_cost;
-                const MinPrioPoint updated = {.point=neighbour,
-                                              .cost=tentative_cost};
-
-                const auto it = open_set.find(updated);
-                open_set.erase(it, open_set.end());
-                open_set.insert(updated);
-            }
+            seed = seed * 6364136223846793005ul + 1442695040888963407ul;
+            c = '1' + (seed >> 33) % 9;
         }
     }
+    return res;
 }
 
 int main()
@@ -150,6 +136,8 @@ int main()
         aoc::assert_equal(dijkstra(grid1), 40ul);
 
         const auto grid2 = parse(test_input, true);
+        aoc::assert_equal(grid2.risk(49, 49), 9ul);
+        aoc::assert_equal(grid2.risk(10, 0), 2ul);
         aoc::assert_equal(dijkstra(grid2), 315ul);
     }
     const auto lines = aoc::get_lines("input.txt");
@@ -160,5 +148,15 @@ int main()
     const auto grid2 = parse(lines, true);
     aoc::assert_equal(dijkstra(grid2), 2844ul); // part 2
 
+    const auto generated = generate(1000, 15);
+    {
+        const aoc::StopWatch watch;
+        aoc::print("1000x1000: ", dijkstra(parse(generated)));
+    }
+    {
+        const aoc::StopWatch watch;
+        aoc::print("5000x5000 tiled: ", dijkstra(parse(generated, true)));
+    }
+
     return 0;
 }
@@ -1,34 +1,55 @@
-#include <numeric>
 #include <algorithm>
+#include <thread>
 #include "aoc_library.hpp"
 
 namespace ranges = std::ranges;
 
-std::string transform_to_bin(const std::string &hex)
+// Hex digits packed two per byte, followed by eight zero bytes so the reader
+// can always load a full 64-bit window.
+std::vector<uint8_t> pack_hex(const std::string &hex)
 {
-    static const std::unordered_map<char, std::string> m =
-        {{'0', "0000"},
-         {'1', "0001"},
-         {'2', "0010"},
-         {'3', "0011"},
-         {'4', "0100"},
-         {'5', "0101"},
-         {'6', "0110"},
-         {'7', "0111"},
-         {'8', "1000"},
-         {'9', "1001"},
-         {'A', "1010"},
-         {'B', "1011"},
-         {'C', "1100"},
-         {'D', "1101"},
-         {'E', "1110"},
-         {'F', "1111"}};
-
-    return std::accumulate(hex.begin(), hex.end(), std::string(),
-                           [](auto acc, const auto c)
-                           { return acc + m.at(c); });
+    const auto nibble = [](const char c)
+    { return static_cast<uint8_t>(c <= '9' ? c - '0' : c - 'A' + 10); };
+
+    std::vector<uint8_t> res((hex.size() + 1) / 2 + 8, 0);
+    for (uint64_t i = 0; i < hex.size(); i++)
+    {
+        res[i / 2] |= nibble(hex[i]) << (i % 2 == 0 ? 4 : 0);
+    }
+    return res;
 }
 
+class BitReader
+{
+public:
+    BitReader(const std::vector<uint8_t> &bytes)
+        : bytes_(bytes)
+    {
+    }
+
+    uint64_t read(uint64_t bits)
+    {
+        assert(bits > 0 && bits <= 57);
+        uint64_t window = 0;
+        for (uint64_t i = 0; i < 8; i++)
+        {
+            window = (window << 8) | bytes_[position_ / 8 + i];
+        }
+        const auto res = (window << (position_ % 8)) >> (64 - bits);
+        position_ += bits;
+        return res;
+    }
+
+    uint64_t position() const
+    {
+        return position_;
+    }
+
+private:
+    const std::vector<uint8_t> &bytes_;
+    uint64_t position_ = 0;
+};
+
 struct Packet
 {
     uint64_t length;
@@ -36,171 +57,481 @@ struct Packet
     uint64_t value;
 };
 
+// Folds operator values one at a time, so no sub-packet values are stored.
+class Reducer
+{
+public:
+    Reducer(uint64_t type)
+        : type_(type)
+    {
+        if (type == 1)
+        {
+            value_ = 1;
+        }
+        else if (type == 2)
+        {
+            value_ = std::numeric_limits<uint64_t>::max();
+        }
+    }
+
+    void push(uint64_t value)
+    {
+        if (type_ == 0)
+        {
+            value_ += value;
+        }
+        else if (type_ == 1)
+        {
+            value_ *= value;
+        }
+        else if (type_ == 2)
+        {
+            value_ = std::min(value_, value);
+        }
+        else if (type_ == 3)
+        {
+            value_ = std::max(value_, value);
+        }
+        else if (count_ == 0)
+        {
+            value_ = value;
+        }
+        else if (type_ == 5)
+        {
+            value_ = value_ > value ? 1 : 0;
+        }
+        else if (type_ == 6)
+        {
+            value_ = value_ < value ? 1 : 0;
+        }
+        else if (type_ == 7)
+        {
+            value_ = value_ == value ? 1 : 0;
+        }
+        count_++;
+    }
+
+    uint64_t value() const
+    {
+        return value_;
+    }
+
+private:
+    uint64_t type_;
+    uint64_t value_ = 0;
+    uint64_t count_ = 0;
+};
+
 uint64_t operate(uint64_t type, const std::vector<uint64_t> &values)
 {
-    if (type == 0)
+    Reducer reducer(type);
+    ranges::for_each(values, [&reducer](const auto v)
+                     { reducer.push(v); });
+    return reducer.value();
+}
+
+// Packets in pre-order as structure-of-arrays indexed by node id. A node's
+// subtree is the id range [id, end_[id]), so its first child is id + 1 and
+// each next sibling starts where the previous one ends.
+class PacketTree
+{
+public:
+    void reserve(uint64_t nodes)
     {
-        return std::accumulate(values.begin(), values.end(), 0ul);
+        types_.reserve(nodes);
+        versions_.reserve(nodes);
+        children_.reserve(nodes);
+        end_.reserve(nodes);
+        values_.reserve(nodes);
     }
-    else if (type == 1)
+
+    uint32_t add(uint8_t type, uint8_t version)
     {
-        return std::accumulate(values.begin(), values.end(), 1ul, std::multiplies<uint64_t>());
+        types_.push_back(type);
+        versions_.push_back(version);
+        children_.push_back(0);
+        end_.push_back(0);
+        values_.push_back(0);
+        return types_.size() - 1;
     }
-    else if (type == 2)
+
+    void add_child(uint32_t parent)
     {
-        return std::accumulate(values.begin(), values.end(), std::numeric_limits<uint64_t>::max(),
-                               [](const auto min, const auto el)
-                               { return el < min ? el : min; });
+        children_[parent]++;
     }
-    else if (type == 3)
+
+    void close(uint32_t node, uint64_t literal = 0)
     {
-        return std::accumulate(values.begin(), values.end(), 0ul,
-                               [](const auto max, const auto el)
-                               { return el < max ? max : el; });
+        end_[node] = types_.size();
+        if (types_[node] == 4)
+        {
+            values_[node] = literal;
+        }
     }
-    else if (type == 5)
+
+    void finish()
     {
-        return values.at(0) > values.at(1) ? 1 : 0;
+        version_prefix_.assign(1, 0);
+        version_prefix_.reserve(size() + 1);
+        for (const auto version : versions_)
+        {
+            version_prefix_.push_back(version_prefix_.back() + version);
+        }
     }
-    else if (type == 6)
+
+    uint64_t size() const
     {
-        return values.at(0) < values.at(1) ? 1 : 0;
+        return types_.size();
     }
-    else if (type == 7)
+
+    uint64_t type(uint32_t node) const
     {
-        return values.at(0) == values.at(1) ? 1 : 0;
+        return types_[node];
     }
-    return 0;
-}
 
-Packet parse_literal(const std::string &s)
-{
-    const uint64_t version = std::stoul(s.substr(0, 3), nullptr, 2);
+    uint64_t child_count(uint32_t node) const
+    {
+        return children_[node];
+    }
 
-    uint64_t p = 6;
-    bool done = false;
-    std::vector<std::string> groups;
-    while (!done)
+    std::vector<uint32_t> children(uint32_t node) const
     {
-        std::string group = s.substr(p, 5);
-        groups.push_back(group.substr(1));
-        p += 5;
-        done = group[0] == '0';
+        std::vector<uint32_t> res;
+        for (auto child = node + 1; child < end_[node]; child = end_[child])
+        {
+            res.push_back(child);
+        }
+        return res;
     }
 
-    uint64_t value = 0;
-    for (int i = 0; const auto &group : groups | ranges::views::reverse)
+    uint64_t version_sum(uint32_t node) const
     {
-        value += std::stoul(group, nullptr, 2) << 4 * i++;
+        return version_prefix_[end_[node]] - version_prefix_[node];
     }
 
-    return {p, version, value};
-}
+    // Valid for operators once evaluate() has run, always valid for literals.
+    uint64_t value(uint32_t node) const
+    {
+        return values_[node];
+    }
+
+    void evaluate()
+    {
+        evaluate_range(0, size());
+    }
 
-Packet parse_packet(const std::string &s)
+    // Outermost operators with at least `wide` children get their children
+    // split into contiguous id ranges, one per thread.
+    void evaluate(unsigned threads, uint64_t wide = 1024)
+    {
+        if (threads <= 1)
+        {
+            evaluate();
+            return;
+        }
+
+        std::vector<uint32_t> wide_nodes;
+        for (uint32_t node = 0; node < size();)
+        {
+            if (children_[node] >= wide)
+            {
+                wide_nodes.push_back(node);
+                node = end_[node];
+            }
+            else
+            {
+                node++;
+            }
+        }
+
+        for (const auto node : wide_nodes)
+        {
+            const auto children = this->children(node);
+            const uint64_t chunk = (children.size() + threads - 1) / threads;
+            std::vector<std::thread> workers;
+            for (uint64_t first = 0; first < children.size(); first += chunk)
+            {
+                const auto last = std::min(first + chunk, children.size()) - 1;
+                workers.emplace_back([this, from = children[first], to = end_[children[last]]]()
+                                     { evaluate_range(from, to); });
+            }
+            ranges::for_each(workers, [](auto &worker)
+                             { worker.join(); });
+        }
+
+        auto next_wide = wide_nodes.size();
+        for (auto node = size(); node-- > 0;)
+        {
+            if (next_wide > 0 && node == end_[wide_nodes[next_wide - 1]] - 1ul)
+            {
+                node = wide_nodes[--next_wide];
+            }
+            reduce(node);
+        }
+    }
+
+private:
+    void evaluate_range(uint32_t from, uint32_t to)
+    {
+        for (auto node = to; node-- > from;)
+        {
+            reduce(node);
+        }
+    }
+
+    void reduce(uint32_t node)
+    {
+        if (types_[node] == 4)
+        {
+            return;
+        }
+        Reducer reducer(types_[node]);
+        for (auto child = node + 1; child < end_[node]; child = end_[child])
+        {
+            reducer.push(values_[child]);
+        }
+        values_[node] = reducer.value();
+    }
+
+    std::vector<uint8_t> types_;
+    std::vector<uint8_t> versions_;
+    std::vector<uint32_t> children_;
+    std::vector<uint32_t> end_;
+    std::vector<uint64_t> values_;
+    std::vector<uint64_t> version_prefix_;
+};
+
+// Decodes the outermost packet with an explicit stack of open operators. Each
+// operator ends either at a bit position or after a number of sub-packets.
+// When a tree is given every packet is also recorded in it.
+Packet decode(const std::vector<uint8_t> &bytes, PacketTree *tree = nullptr)
 {
-    const uint64_t version = std::stoul(s.substr(0, 3), nullptr, 2);
-    const uint64_t type = std::stoul(s.substr(3, 3), nullptr, 2);
+    struct Operator
+    {
+        Reducer reducer;
+        bool by_length;
+        uint64_t limit;
+        uint32_t node;
+    };
+
+    BitReader reader(bytes);
+    std::vector<Operator> open;
+    uint64_t version_acc = 0;
+    if (tree)
+    {
+        // Every packet takes at least 11 bits.
+        tree->reserve(bytes.size() * 8 / 11 + 1);
+    }
+
+    const auto finished = [&reader](const Operator &op)
+    { return op.by_length ? reader.position() >= op.limit : op.limit == 0; };
 
-    if (type == 4ul)
+    while (true)
     {
-        return parse_literal(s);
+        const uint64_t version = reader.read(3);
+        const uint64_t type = reader.read(3);
+        version_acc += version;
+        uint32_t node = 0;
+        if (tree)
+        {
+            if (!open.empty())
+            {
+                tree->add_child(open.back().node);
+            }
+            node = tree->add(type, version);
+        }
+        if (type != 4)
+        {
+            const bool by_length = reader.read(1) == 0;
+            const uint64_t limit = by_length ? reader.read(15) : reader.read(11);
+            open.push_back({Reducer(type), by_length, by_length ? reader.position() + limit : limit, node});
+            if (!finished(open.back()))
+            {
+                continue;
+            }
+        }
+
+        uint64_t value = 0;
+        if (type == 4)
+        {
+            for (bool more = true; more;)
+            {
+                more = reader.read(1) == 1;
+                value = (value << 4) | reader.read(4);
+            }
+            if (tree)
+            {
+                tree->close(node, value);
+            }
+        }
+        else
+        {
+            value = open.back().reducer.value();
+            if (tree)
+            {
+                tree->close(open.back().node);
+            }
+            open.pop_back();
+        }
+
+        while (!open.empty())
+        {
+            auto &parent = open.back();
+            parent.reducer.push(value);
+            if (!parent.by_length)
+            {
+                parent.limit--;
+            }
+            if (!finished(parent))
+            {
+                break;
+            }
+            value = parent.reducer.value();
+            if (tree)
+            {
+                tree->close(parent.node);
+            }
+            open.pop_back();
+        }
+        if (open.empty())
+        {
+            if (tree)
+            {
+                tree->finish();
+            }
+            return {reader.position(), version_acc, value};
+        }
     }
+}
 
-    uint64_t version_acc = version;
-    std::vector<uint64_t> values;
-    uint64_t packet_length = 0;
+Packet decode(const std::string &hex, PacketTree *tree = nullptr)
+{
+    return decode(pack_hex(hex), tree);
+}
 
-    if (s[6] == '0')
+class BitWriter
+{
+public:
+    void write(uint64_t value, uint64_t bits)
     {
-        const uint64_t initial_offset = 7 + 15;
-        const uint64_t expected_length = std::stoul(s.substr(7, 15), nullptr, 2) + initial_offset;
-        packet_length = initial_offset;
-        while (packet_length < expected_length)
+        for (uint64_t i = bits; i > 0; i--)
         {
-            const auto [l, v, x] = parse_packet(s.substr(packet_length));
-            packet_length += l;
-            version_acc += v;
-            values.push_back(x);
+            bits_.push_back((value >> (i - 1)) & 1);
         }
     }
-    else
+
+    std::string hex() const
     {
-        const uint64_t nr_sub_packets = std::stoul(s.substr(7, 11), nullptr, 2);
-        packet_length = 7 + 11;
-        for (uint64_t i = 0; i < nr_sub_packets; i++)
+        std::string res;
+        for (uint64_t i = 0; i < bits_.size(); i += 4)
         {
-            const auto [l, v, x] = parse_packet(s.substr(packet_length));
-            packet_length += l;
-            version_acc += v;
-            values.push_back(x);
+            uint64_t nibble = 0;
+            for (uint64_t j = i; j < i + 4; j++)
+            {
+                nibble = (nibble << 1) | (j < bits_.size() && bits_[j]);
+            }
+            res.push_back("0123456789ABCDEF"[nibble]);
         }
+        return res;
     }
-    return {packet_length, version_acc, operate(type, values)};
+
+private:
+    std::vector<bool> bits_;
+};
+
+// A sum of `groups` sums of `width` literals each, plus a chain of `depth`
+// nested single-child sums around a literal 1.
+std::string generate(uint64_t groups, uint64_t width, uint64_t depth)
+{
+    BitWriter writer;
+    writer.write(0, 6);
+    writer.write(1, 1);
+    writer.write(groups + 1, 11);
+    for (uint64_t g = 0; g < groups; g++)
+    {
+        writer.write(0, 6);
+        writer.write(1, 1);
+        writer.write(width, 11);
+        for (uint64_t i = 0; i < width; i++)
+        {
+            writer.write(4, 6);
+            writer.write(i % 16, 5);
+        }
+    }
+    for (uint64_t d = 0; d < depth; d++)
+    {
+        writer.write(1, 3);
+        writer.write(0, 3);
+        writer.write(1, 1);
+        writer.write(1, 11);
+    }
+    writer.write(4, 6);
+    writer.write(1, 5);
+    return writer.hex();
 }
 
 int main()
 {
     const aoc::StopWatch stop_watch;
     {
-        auto [length, version_acc, value] = parse_packet(transform_to_bin("D2FE28"));
+        auto [length, version_acc, value] = decode("D2FE28");
         aoc::assert_equal(length, 21ul);
         aoc::assert_equal(value, 2021ul);
     }
     {
-        const auto [length, version_acc, x] = parse_packet(transform_to_bin("38006F45291200"));
+        const auto [length, version_acc, x] = decode("38006F45291200");
         aoc::assert_equal(version_acc, 9ul);
     }
     {
-        const auto [length, version_acc, x] = parse_packet(transform_to_bin("EE00D40C823060"));
+        const auto [length, version_acc, x] = decode("EE00D40C823060");
         aoc::assert_equal(version_acc, 14ul);
     }
     {
-        const auto [length, version_acc, x] = parse_packet(transform_to_bin("8A004A801A8002F478"));
+        const auto [length, version_acc, x] = decode("8A004A801A8002F478");
         aoc::assert_equal(version_acc, 16ul);
     }
     {
-        const auto [length, version_acc, x] = parse_packet(transform_to_bin("620080001611562C8802118E34"));
+        const auto [length, version_acc, x] = decode("620080001611562C8802118E34");
         aoc::assert_equal(version_acc, 12ul);
     }
     {
-        const auto [length, version_acc, x] = parse_packet(transform_to_bin("C0015000016115A2E0802F182340"));
+        const auto [length, version_acc, x] = decode("C0015000016115A2E0802F182340");
         aoc::assert_equal(version_acc, 23ul);
     }
     {
-        const auto [length, version_acc, x] = parse_packet(transform_to_bin("A0016C880162017C3686B18A3D4780"));
+        const auto [length, version_acc, x] = decode("A0016C880162017C3686B18A3D4780");
         aoc::assert_equal(version_acc, 31ul);
     }
     {
-        const auto [length, version_acc, value] = parse_packet(transform_to_bin("C200B40A82"));
+        const auto [length, version_acc, value] = decode("C200B40A82");
         aoc::assert_equal(value, 3ul);
     }
     {
-        const auto [length, version_acc, value] = parse_packet(transform_to_bin("04005AC33890"));
+        const auto [length, version_acc, value] = decode("04005AC33890");
         aoc::assert_equal(value, 54ul);
     }
     {
-        const auto [length, version_acc, value] = parse_packet(transform_to_bin("880086C3E88112"));
+        const auto [length, version_acc, value] = decode("880086C3E88112");
         aoc::assert_equal(value, 7ul);
     }
     {
-        const auto [length, version_acc, value] = parse_packet(transform_to_bin("CE00C43D881120"));
+        const auto [length, version_acc, value] = decode("CE00C43D881120");
         aoc::assert_equal(value, 9ul);
     }
     {
-        const auto [length, version_acc, value] = parse_packet(transform_to_bin("D8005AC2A8F0"));
+        const auto [length, version_acc, value] = decode("D8005AC2A8F0");
         aoc::assert_equal(value, 1ul);
     }
     {
-        const auto [length, version_acc, value] = parse_packet(transform_to_bin("F600BC2D8F"));
+        const auto [length, version_acc, value] = decode("F600BC2D8F");
         aoc::assert_equal(value, 0ul);
     }
     {
-        const auto [length, version_acc, value] = parse_packet(transform_to_bin("9C005AC2F8F0"));
+        const auto [length, version_acc, value] = decode("9C005AC2F8F0");
         aoc::assert_equal(value, 0ul);
     }
     {
-        const auto [length, version_acc, value] = parse_packet(transform_to_bin("9C0141080250320F1802104A08"));
+        const auto [length, version_acc, value] = decode("9C0141080250320F1802104A08");
         aoc::assert_equal(value, 1ul);
     }
 
@@ -212,9 +543,46 @@ int main()
 
     const auto lines = aoc::get_lines("input.txt");
 
-    const auto [length, version_acc, value] = parse_packet(transform_to_bin(lines[0]));
+    const auto [length, version_acc, value] = decode(lines[0]);
     aoc::assert_equal(version_acc, 877ul);    // part 1
     aoc::assert_equal(value, 194435634456ul); // part 2
+    {
+        PacketTree tree;
+        decode(lines[0], &tree);
+        tree.evaluate();
+        aoc::assert_equal(tree.version_sum(0), 877ul);
+        aoc::assert_equal(tree.value(0), 194435634456ul);
+    }
+
+    {
+        const auto transmission = generate(1000, 1000, 100000);
+        const aoc::StopWatch watch;
+        const auto [length, version_acc, value] = decode(transmission);
+        aoc::assert_equal(value, 1000 * (1000 / 16 * 120 + 28) + 1ul);
+        aoc::assert_equal(version_acc, 100000ul);
+        aoc::print("decoded ", transmission.size() / 2, " bytes");
+
+        PacketTree tree;
+        {
+            const aoc::StopWatch tree_watch;
+            decode(transmission, &tree);
+            aoc::print("built tree with ", tree.size(), " nodes");
+        }
+        aoc::assert_equal(tree.child_count(0), 1001ul);
+        {
+            const aoc::StopWatch evaluate_watch;
+            tree.evaluate();
+            aoc::assert_equal(tree.value(0), value);
+        }
+        {
+            const aoc::StopWatch parallel_watch;
+            tree.evaluate(std::max(2u, std::thread::hardware_concurrency()), 512);
+            aoc::assert_equal(tree.value(0), value);
+        }
+        const auto groups = tree.children(0);
+        aoc::assert_equal(tree.value(groups[0]), 7468ul);
+        aoc::assert_equal(tree.version_sum(groups.back()), 100000ul);
+    }
 
     return 0;
 }
@@ -1,5 +1,6 @@
 #include <cmath>
-#include <math.h>
+#include <numeric>
+#include <thread>
 #include "aoc_library.hpp"
 
 namespace ranges = std::ranges;
@@ -12,60 +13,215 @@ struct Target
     int64_t xmax;
 };
 
-inline uint64_t will_it_hit(const Target &target, int64_t vx, int64_t vy)
+// Inclusive range of steps during which the probe is inside the target along
+// one axis. `last` is max() when the probe stops inside the target.
+struct StepRange
 {
-    int64_t step = 0;
-    while (true)
+    int64_t first;
+    int64_t last;
+
+    bool empty() const
+    {
+        return first > last;
+    }
+};
+
+inline int64_t isqrt(int64_t n)
+{
+    int64_t r = std::sqrt(static_cast<long double>(n));
+    while (r * r > n)
+    {
+        r--;
+    }
+    while ((r + 1) * (r + 1) <= n)
     {
-        step++;
+        r++;
+    }
+    return r;
+}
+
+inline int64_t triangle(int64_t n)
+{
+    return n * (n + 1) / 2;
+}
 
-        const int64_t vxms = std::max(vx - step, 0l);
-        const int64_t xpos = (vx * (vx + 1) / 2) - (vxms * (vxms + 1) / 2);
+// Position after `step` steps: v * t - t * (t - 1) / 2, where x stops changing
+// once the drag has brought vx to zero.
+inline int64_t x_at(int64_t vx, int64_t step)
+{
+    return step >= vx ? triangle(vx) : vx * step - triangle(step - 1);
+}
+
+inline int64_t y_at(int64_t vy, int64_t step)
+{
+    return vy * step - triangle(step - 1);
+}
 
-        int64_t acc_ypos = 0;
-        int64_t vy_stepper = vy;
-        for (int64_t i = 0; i < step; i++)
+// Expects a target below the launcher and ahead of it (xmin > 0 > ymax).
+// The crossing steps come from solving t^2 - (2v + 1)t + 2p = 0 for the
+// target edges; the integer square root is off by at most one step, which the
+// adjustment loops correct.
+class TrajectorySolver
+{
+public:
+    TrajectorySolver(const Target &target)
+        : target_(target)
+    {
+        assert(target.xmin > 0 && target.ymax < 0);
+        for (int64_t vy = target.ymin; vy < -target.ymin; vy++)
         {
-            acc_ypos += vy_stepper;
-            vy_stepper--;
+            const auto range = y_steps(vy);
+            if (!range.empty())
+            {
+                y_first_.push_back(range.first);
+                y_last_.push_back(range.last);
+            }
         }
+    }
 
-        if (xpos >= target.xmin && xpos <= target.xmax &&
-            acc_ypos >= target.ymin && acc_ypos <= target.ymax)
+    StepRange x_steps(int64_t vx) const
+    {
+        if (vx <= 0 || triangle(vx) < target_.xmin)
+        {
+            return {1, 0};
+        }
+        const auto b = 2 * vx + 1;
+        int64_t first = std::max(1l, (b - isqrt(b * b - 8 * target_.xmin)) / 2);
+        while (first > 1 && x_at(vx, first - 1) >= target_.xmin)
+        {
+            first--;
+        }
+        while (x_at(vx, first) < target_.xmin)
         {
-            return step;
+            first++;
         }
-        if (xpos > target.xmax || acc_ypos < target.ymin)
+        if (triangle(vx) <= target_.xmax)
         {
-            break;
+            return {first, std::numeric_limits<int64_t>::max()};
         }
+        int64_t last = (b - isqrt(b * b - 8 * target_.xmax)) / 2;
+        while (x_at(vx, last + 1) <= target_.xmax)
+        {
+            last++;
+        }
+        while (last >= 1 && x_at(vx, last) > target_.xmax)
+        {
+            last--;
+        }
+        return {first, last};
     }
-    return 0;
-}
 
-std::vector<std::pair<int64_t, int64_t>> generate_velocities(const Target &target)
-{
-    std::vector<std::pair<int64_t, int64_t>> res;
+    StepRange y_steps(int64_t vy) const
+    {
+        const auto b = 2 * vy + 1;
+        int64_t first = std::max(1l, (b + isqrt(b * b - 8 * target_.ymax)) / 2);
+        while (first > 1 && y_at(vy, first - 1) <= target_.ymax)
+        {
+            first--;
+        }
+        while (y_at(vy, first) > target_.ymax)
+        {
+            first++;
+        }
+        int64_t last = (b + isqrt(b * b - 8 * target_.ymin)) / 2;
+        while (y_at(vy, last + 1) >= target_.ymin)
+        {
+            last++;
+        }
+        while (last >= 1 && y_at(vy, last) < target_.ymin)
+        {
+            last--;
+        }
+        return {first, last};
+    }
 
-    const int64_t start_x_it = -0.5 + std::sqrt(2 * target.xmin);
-    const int64_t end_x = target.xmax;
-    const int64_t start_y = -1 * target.ymin;
+    // Both ends of the y step range grow with vy, so the vy whose range
+    // overlaps a given x range are one contiguous run found by binary search.
+    uint64_t count_for(int64_t vx) const
+    {
+        const auto x = x_steps(vx);
+        if (x.empty())
+        {
+            return 0;
+        }
+        const auto lo = ranges::lower_bound(y_last_, x.first) - y_last_.begin();
+        const auto hi = ranges::upper_bound(y_first_, x.last) - y_first_.begin();
+        return std::max(0l, hi - lo);
+    }
 
-    for (int x = start_x_it; x <= end_x; x++)
+    uint64_t count(unsigned threads = 1) const
     {
-        for (int y = start_y; y >= target.ymin; y--)
+        const int64_t vx_end = target_.xmax + 1;
+        if (threads <= 1)
         {
-            res.push_back({x, y});
+            uint64_t res = 0;
+            for (int64_t vx = 1; vx < vx_end; vx++)
+            {
+                res += count_for(vx);
+            }
+            return res;
         }
+
+        std::vector<uint64_t> counts(threads, 0);
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; t++)
+        {
+            workers.emplace_back([this, t, threads, vx_end, &counts]()
+                                 {
+                                     for (int64_t vx = 1 + t; vx < vx_end; vx += threads)
+                                     {
+                                         counts[t] += count_for(vx);
+                                     }
+                                 });
+        }
+        ranges::for_each(workers, [](auto &worker)
+                         { worker.join(); });
+        return std::accumulate(counts.begin(), counts.end(), 0ul);
     }
 
-    return res;
+private:
+    Target target_;
+    std::vector<int64_t> y_first_;
+    std::vector<int64_t> y_last_;
+};
+
+inline uint64_t will_it_hit(const Target &target, int64_t vx, int64_t vy)
+{
+    const TrajectorySolver solver(target);
+    const auto x = solver.x_steps(vx);
+    const auto y = solver.y_steps(vy);
+    const auto first = std::max(x.first, y.first);
+    return first <= std::min(x.last, y.last) ? first : 0;
 }
 
-uint64_t possible_initial_values(const Target &target)
+uint64_t possible_initial_values(const Target &target, unsigned threads = 1)
 {
-    return ranges::count_if(generate_velocities(target), [&target](const auto &p)
-                            { return will_it_hit(target, p.first, p.second); });
+    return TrajectorySolver(target).count(threads);
+}
+
+// Reference count by flying every launch step by step.
+uint64_t simulated_initial_values(const Target &target)
+{
+    uint64_t res = 0;
+    for (int64_t vx = 1; vx <= target.xmax; vx++)
+    {
+        for (int64_t vy = target.ymin; vy < -target.ymin; vy++)
+        {
+            int64_t x = 0;
+            int64_t y = 0;
+            for (int64_t dx = vx, dy = vy; x <= target.xmax && y >= target.ymin; dx -= dx > 0, dy--)
+            {
+                x += dx;
+                y += dy;
+                if (x >= target.xmin && x <= target.xmax && y >= target.ymin && y <= target.ymax)
+                {
+                    res++;
+                    break;
+                }
+            }
+        }
+    }
+    return res;
 }
 
 int main()
@@ -80,10 +236,37 @@ int main()
         aoc::assert_equal(will_it_hit(target, 20, -4), 0ul);
 
         aoc::assert_equal(possible_initial_values(target), 112ul);
+        aoc::assert_equal(simulated_initial_values(target), 112ul);
     }
 
     Target target = {-100, -76, 144, 178}; // puzzle input
     aoc::assert_equal(possible_initial_values(target), 1477ul);
+    aoc::assert_equal(possible_initial_values(target, 3), 1477ul);
+    aoc::assert_equal(simulated_initial_values(target), 1477ul);
+
+    {
+        const Target far = {-300, -250, 400, 500};
+        const TrajectorySolver solver(far);
+        uint64_t pairwise = 0;
+        for (int64_t vx = 1; vx <= far.xmax; vx++)
+        {
+            const auto x = solver.x_steps(vx);
+            for (int64_t vy = far.ymin; vy < -far.ymin && !x.empty(); vy++)
+            {
+                const auto y = solver.y_steps(vy);
+                pairwise += std::max(x.first, y.first) <= std::min(x.last, y.last);
+            }
+        }
+        aoc::assert_equal(solver.count(), pairwise);
+        aoc::assert_equal(pairwise, 8740ul);
+        aoc::assert_equal(simulated_initial_values(far), 8740ul);
+    }
+    {
+        const aoc::StopWatch watch;
+        const Target far = {-200000, -150000, 300000, 400000};
+        const auto threads = std::max(2u, std::thread::hardware_concurrency());
+        aoc::print("far target: ", possible_initial_values(far, threads));
+    }
 
     return 0;
 }
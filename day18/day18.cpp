@@ -1,398 +1,335 @@
-#include <variant>
-#include <math.h>
+#include <atomic>
+#include <thread>
 #include "aoc_library.hpp"
 
 namespace ranges = std::ranges;
 
-struct SnailPair
+// A snailfish number as its regular numbers from left to right, each with the
+// number of pairs it is nested in. The pair structure follows from the depths
+// alone, so every operation is a scan over at most a few dozen bytes.
+class Snail
 {
-    uint64_t id;
-    std::weak_ptr<SnailPair> parent;
-    std::variant<std::shared_ptr<SnailPair>, uint64_t> left;
-    std::variant<std::shared_ptr<SnailPair>, uint64_t> right;
+public:
+    // Two reduced numbers hold at most 16 regular numbers each, and reducing
+    // their sum never has more than one extra pair open at a time.
+    static constexpr uint64_t capacity = 40;
 
-    void print() const
+    static Snail parse(const std::string &line)
     {
-        const auto print_variant = [](const auto &variant)
+        Snail res;
+        uint8_t depth = 0;
+        for (const auto c : line)
         {
-            if (std::holds_alternative<std::shared_ptr<SnailPair>>(variant))
+            if (c == '[')
             {
-                std::get<std::shared_ptr<SnailPair>>(variant)->print();
+                depth++;
             }
-            else
+            else if (c == ']')
             {
-                aoc::printnl(std::get<uint64_t>(variant));
+                depth--;
+            }
+            else if (c != ',')
+            {
+                assert(res.size_ < capacity);
+                res.values_[res.size_] = c - '0';
+                res.depths_[res.size_++] = depth;
             }
-        };
-        aoc::printnl("[");
-        print_variant(right);
-        aoc::printnl(",");
-        print_variant(left);
-        aoc::printnl("]");
-        if (!parent.lock()) [[unlikely]]
-        {
-            aoc::print("");
         }
+        return res;
     }
-};
-
-typedef std::shared_ptr<SnailPair> SnailPtr;
-
-inline bool should_split(const std::variant<SnailPtr, uint64_t> &head)
-{
-    return std::holds_alternative<uint64_t>(head) && std::get<uint64_t>(head) >= 10ul;
-}
 
-inline std::optional<SnailPtr> search_split(const SnailPtr &snail)
-{
-    if (should_split(snail->left))
+    uint64_t size() const
     {
-        return snail;
+        return size_;
     }
-    else if (std::holds_alternative<SnailPtr>(snail->left))
+
+    // Combines the two innermost neighbours with equal depth, left to right,
+    // like a shift-reduce parser.
+    uint64_t magnitude() const
     {
-        const auto left = search_split(std::get<SnailPtr>(snail->left));
-        if (left)
+        std::array<uint64_t, capacity> values;
+        std::array<uint8_t, capacity> depths;
+        uint64_t top = 0;
+        for (uint64_t i = 0; i < size_; i++)
         {
-            return left;
+            values[top] = values_[i];
+            depths[top++] = depths_[i];
+            while (top >= 2 && depths[top - 1] == depths[top - 2])
+            {
+                values[top - 2] = 3 * values[top - 2] + 2 * values[top - 1];
+                depths[top - 2]--;
+                top--;
+            }
         }
+        return values[0];
     }
-    if (should_split(snail->right))
+
+    std::string to_string() const
     {
-        return snail;
+        std::string res;
+        uint64_t i = 0;
+        append(res, i, 0);
+        return res;
     }
-    else if (std::holds_alternative<SnailPtr>(snail->right))
+
+    // Single reduction actions, as described by the puzzle.
+    bool explode()
     {
-        const auto right = search_split(std::get<SnailPtr>(snail->right));
-        if (right)
+        for (uint64_t i = 0; i + 1 < size_; i++)
         {
-            return right;
+            if (depths_[i] > 4)
+            {
+                explode_at(i);
+                return true;
+            }
         }
+        return false;
     }
-    return std::nullopt;
-}
-
-struct Generator
-{
-    static const uint64_t max_nr_in_input = 10ul;
-    uint64_t unique_id_ = max_nr_in_input;
 
-    inline SnailPtr parse_line(const std::string line)
+    bool split()
     {
-        std::string line_cp = line;
-        std::unordered_map<uint64_t, SnailPtr> parse_map;
-
-        while (true)
+        for (uint64_t i = 0; i < size_; i++)
         {
-            const static std::regex search_re("\\[(\\d+),(\\d+)\\]");
-            const auto [l, r] = aoc::search<2>(line_cp, search_re);
-
-            uint64_t left_nr = 0;
-            uint64_t right_nr = 0;
-            try
+            if (values_[i] >= 10)
             {
-                left_nr = std::stoul(l);
-                right_nr = std::stoul(r);
-            }
-            catch (const std::exception &)
-            {
-                // Done parsing line
-                break;
+                split_at(i);
+                return true;
             }
+        }
+        return false;
+    }
 
-            auto pair = std::make_shared<SnailPair>();
-            pair->id = unique_id_++;
-            if (left_nr < max_nr_in_input)
-            {
-                pair->left = left_nr;
-            }
-            else
-            {
-                auto kid = parse_map.at(left_nr);
-                pair->left = kid;
-                kid->parent = pair;
-            }
-            if (right_nr < max_nr_in_input)
-            {
-                pair->right = right_nr;
-            }
-            else
+    // Overwrites this number with the reduced sum, so a caller can reuse one
+    // scratch number for many additions.
+    void assign_sum(const Snail &lhs, const Snail &rhs)
+    {
+        assert(lhs.size_ + rhs.size_ <= capacity);
+        size_ = 0;
+        for (const auto *part : {&lhs, &rhs})
+        {
+            for (uint64_t i = 0; i < part->size_; i++)
             {
-                auto kid = parse_map.at(right_nr);
-                pair->right = kid;
-                kid->parent = pair;
+                values_[size_] = part->values_[i];
+                depths_[size_++] = part->depths_[i] + 1;
             }
-            parse_map.emplace(unique_id_, pair);
-
-            const static std::regex replace_re("(\\[\\d+,\\d+\\])");
-            line_cp = std::regex_replace(line_cp, replace_re, std::to_string(unique_id_),
-                                         std::regex_constants::format_first_only);
         }
-        return parse_map.at(std::stoul(line_cp));
+        reduce();
     }
 
-    inline SnailPtr add(const SnailPtr &lhs, const SnailPtr &rhs)
+    friend Snail addition(const Snail &lhs, const Snail &rhs)
     {
-        const auto new_pair = std::make_shared<SnailPair>();
-        new_pair->id = unique_id_++;
-        new_pair->left = lhs;
-        lhs->parent = new_pair;
-        new_pair->right = rhs;
-        rhs->parent = new_pair;
-        return new_pair;
+        Snail res;
+        res.assign_sum(lhs, rhs);
+        return res;
     }
 
-    inline bool split(const SnailPtr &snail)
+private:
+    void append(std::string &res, uint64_t &i, uint8_t depth) const
     {
-        const auto to_split = search_split(snail);
-        if (!to_split.has_value())
+        if (depths_[i] == depth)
         {
-            return false;
-        }
-        const auto split_snail = to_split.value();
-
-        const auto new_pair = std::make_shared<SnailPair>();
-        new_pair->id = unique_id_++;
-        new_pair->parent = split_snail;
-
-        long double half = 0;
-        if (should_split(split_snail->left))
-        {
-            half = (long double)std::get<uint64_t>(split_snail->left) / 2.0;
-            split_snail->left = new_pair;
-        }
-        else
-        {
-            half = (long double)std::get<uint64_t>(split_snail->right) / 2.0;
-            split_snail->right = new_pair;
+            res += std::to_string(values_[i++]);
+            return;
         }
-        new_pair->left = (uint64_t)std::floor(half);
-        new_pair->right = (uint64_t)std::ceil(half);
-        return true;
+        res.push_back('[');
+        append(res, i, depth + 1);
+        res.push_back(',');
+        append(res, i, depth + 1);
+        res.push_back(']');
     }
-};
 
-inline uint64_t magnitude(const SnailPtr &snail)
-{
-    const auto get_magnitude = [](const auto &variant)
+    void explode_at(uint64_t i)
     {
-        if (std::holds_alternative<SnailPtr>(variant))
+        if (i > 0)
         {
-            return magnitude(std::get<SnailPtr>(variant));
+            values_[i - 1] += values_[i];
         }
-        else
+        if (i + 2 < size_)
         {
-            return std::get<uint64_t>(variant);
+            values_[i + 2] += values_[i + 1];
         }
-    };
-    const uint64_t left_mag = get_magnitude(snail->left);
-    const uint64_t right_mag = get_magnitude(snail->right);
-    return left_mag * 3 + right_mag * 2;
-}
+        values_[i] = 0;
+        depths_[i]--;
+        std::copy(values_.begin() + i + 2, values_.begin() + size_, values_.begin() + i + 1);
+        std::copy(depths_.begin() + i + 2, depths_.begin() + size_, depths_.begin() + i + 1);
+        size_--;
+    }
 
-typedef std::function<std::variant<SnailPtr, uint64_t> &(SnailPtr)> SearchParentFunc;
+    void split_at(uint64_t i)
+    {
+        assert(size_ < capacity);
+        std::copy_backward(values_.begin() + i + 1, values_.begin() + size_, values_.begin() + size_ + 1);
+        std::copy_backward(depths_.begin() + i + 1, depths_.begin() + size_, depths_.begin() + size_ + 1);
+        size_++;
+        const uint8_t value = values_[i];
+        values_[i] = value / 2;
+        values_[i + 1] = value - value / 2;
+        depths_[i + 1] = ++depths_[i];
+    }
 
-inline void add_to_first_on_side(const SnailPtr &snail, uint64_t val,
-                                 SearchParentFunc search_up_side, SearchParentFunc search_down_side)
-{
-    auto snail_it = snail;
-    // search up
-    while (true)
+    // Only the sum of two reduced numbers can be too deep, so one pass clears
+    // all explosions. After that a split can only create a pair deep enough to
+    // explode at once, which may push the number to its left past 9, so the
+    // scan resumes there.
+    void reduce()
     {
-        const auto parent = snail_it->parent.lock();
-        if (!parent)
+        for (uint64_t i = 0; i + 1 < size_; i++)
         {
-            return;
-        }
-        auto &search_up_child = search_up_side(parent);
-        if (std::holds_alternative<SnailPtr>(search_up_child))
-        {
-            const auto ptr = std::get<SnailPtr>(search_up_child);
-            if (ptr->id != snail_it->id)
+            if (depths_[i] > 4)
             {
-                snail_it = ptr;
-                break; // search down for right most of sibling
+                explode_at(i);
             }
         }
-        else
-        {
-            search_up_child = std::get<uint64_t>(search_up_child) + val;
-            return;
-        }
-        snail_it = parent;
-    }
-    // search down
-    while (true)
-    {
-        auto &search_down_child = search_down_side(snail_it);
-        if (std::holds_alternative<SnailPtr>(search_down_child))
-        {
-            snail_it = std::get<SnailPtr>(search_down_child);
-            continue; // keep searching
-        }
-        else
+        for (uint64_t i = 0; i < size_;)
         {
-            search_down_child = std::get<uint64_t>(search_down_child) + val;
-            return;
+            if (values_[i] < 10)
+            {
+                i++;
+                continue;
+            }
+            split_at(i);
+            if (depths_[i] > 4)
+            {
+                explode_at(i);
+                i = i > 0 ? i - 1 : 0;
+            }
         }
     }
-}
 
-inline std::variant<SnailPtr, uint64_t> &search_left(const SnailPtr &parent)
-{
-    return parent->left;
-}
-
-inline std::variant<SnailPtr, uint64_t> &search_right(const SnailPtr &parent)
-{
-    return parent->right;
-}
+    std::array<uint8_t, capacity> values_;
+    std::array<uint8_t, capacity> depths_;
+    uint8_t size_ = 0;
+};
 
-inline void add_to_first_left(const SnailPtr &snail, uint64_t val)
+inline uint64_t magnitude(const Snail &snail)
 {
-    add_to_first_on_side(snail, val, search_left, search_right);
+    return snail.magnitude();
 }
 
-inline void add_to_first_right(const SnailPtr &snail, uint64_t val)
+std::vector<Snail> parse(const std::vector<std::string> &lines)
 {
-    add_to_first_on_side(snail, val, search_right, search_left);
+    std::vector<Snail> res;
+    res.reserve(lines.size());
+    ranges::transform(lines, std::back_inserter(res), Snail::parse);
+    return res;
 }
 
-inline std::optional<SnailPtr> search_explode(const SnailPtr &snail, uint64_t nested_in)
+uint64_t homework_p1(const std::vector<std::string> &lines)
 {
-    if (nested_in >= 4)
+    const auto snails = parse(lines);
+    auto sum = snails[0];
+    for (const auto &snail : snails | ranges::views::drop(1))
     {
-        return snail;
+        sum = addition(sum, snail);
     }
-    if (std::holds_alternative<SnailPtr>(snail->left))
-    {
-        const auto left = search_explode(std::get<SnailPtr>(snail->left), nested_in + 1);
-        if (left)
-        {
-            return left;
-        }
-    }
-    if (std::holds_alternative<SnailPtr>(snail->right))
-    {
-        const auto right = search_explode(std::get<SnailPtr>(snail->right), nested_in + 1);
-        if (right)
-        {
-            return right;
-        }
-    }
-    return std::nullopt;
+    return magnitude(sum);
 }
 
-inline bool explode(const SnailPtr &snail)
+struct PairMaximum
 {
-    // search for explode criteria (a pair is nested inside four pairs)
-    // not found? return false
-    const auto to_explode = search_explode(snail, 0ul);
-    if (!to_explode.has_value())
-    {
-        return false;
-    }
-    // found?
-    // search for first number to the left and right to give add values
-    const auto explode_snail = to_explode.value();
-    add_to_first_left(explode_snail, std::get<uint64_t>(explode_snail->left));
-    add_to_first_right(explode_snail, std::get<uint64_t>(explode_snail->right));
-    // replace exploding with 0
-    const auto parent = explode_snail->parent.lock();
-    if (std::holds_alternative<SnailPtr>(parent->left) &&
-        std::get<SnailPtr>(parent->left)->id == explode_snail->id)
-    {
-        parent->left = 0ul;
-    }
-    else
-    {
-        parent->right = 0ul;
-    }
-
-    return true;
-}
+    uint64_t magnitude = 0;
+    uint64_t lhs = 0;
+    uint64_t rhs = 0;
+};
 
-inline SnailPtr addition(const SnailPtr &lhs, const SnailPtr &rhs, Generator &gen)
+// Rows of the n x n sum table are handed out through an atomic counter. Each
+// worker keeps its own scratch number and best pair, merged once at the end;
+// ties go to the first pair in row-major order.
+PairMaximum largest_pair_sum(const std::vector<Snail> &snails, unsigned threads = 1)
 {
-    const auto new_pair = gen.add(lhs, rhs);
-    while (true)
+    std::atomic<uint64_t> next_row = 0;
+    std::vector<PairMaximum> best(std::max(threads, 1u));
+
+    const auto work = [&snails, &next_row](PairMaximum &local)
     {
-        if (explode(new_pair))
-        {
-            continue;
-        }
-        if (!gen.split(new_pair))
+        Snail scratch;
+        for (uint64_t a = next_row++; a < snails.size(); a = next_row++)
         {
-            break;
+            for (uint64_t b = 0; b < snails.size(); b++)
+            {
+                if (a == b)
+                {
+                    continue;
+                }
+                scratch.assign_sum(snails[a], snails[b]);
+                const auto mag = scratch.magnitude();
+                if (mag > local.magnitude ||
+                    (mag == local.magnitude && std::make_pair(a, b) < std::make_pair(local.lhs, local.rhs)))
+                {
+                    local = {mag, a, b};
+                }
+            }
         }
-    }
-    return new_pair;
-}
+    };
 
-uint64_t homework_p1(const std::vector<std::string> &lines)
-{
-    Generator gen;
-    auto sum = gen.parse_line(lines[0]);
-    for (const auto &line : lines | ranges::views::drop(1))
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threads; t++)
     {
-        sum = addition(sum, gen.parse_line(line), gen);
+        workers.emplace_back(work, std::ref(best[t]));
     }
-    return magnitude(sum);
+    work(best[0]);
+    ranges::for_each(workers, [](auto &worker)
+                     { worker.join(); });
+
+    return ranges::max(best, [](const auto &lhs, const auto &rhs)
+                       { return std::make_tuple(lhs.magnitude, rhs.lhs, rhs.rhs) <
+                                std::make_tuple(rhs.magnitude, lhs.lhs, lhs.rhs); });
 }
 
 uint64_t homework_p2(const std::vector<std::string> &lines)
 {
-    Generator gen;
-    const auto parsed_lines = ranges::views::transform(lines, [&gen](const auto &line)
-                                                       { return gen.parse_line(line); });
-    uint64_t largest_mag = 0;
-    for (uint64_t a = 0; a < parsed_lines.size(); a++)
+    return largest_pair_sum(parse(lines)).magnitude;
+}
+
+std::string generate_snail(uint64_t &seed, uint64_t depth = 0)
+{
+    seed = seed * 6364136223846793005ul + 1442695040888963407ul;
+    if (depth == 4 || (depth > 0 && (seed >> 60) < 5))
     {
-        for (uint64_t b = 0; b < parsed_lines.size(); b++)
-        {
-            if (a == b)
-            {
-                continue;
-            }
-            const auto mag = magnitude(addition(parsed_lines[a], parsed_lines[b], gen));
-            largest_mag = std::max(mag, largest_mag);
-        }
+        return std::to_string((seed >> 33) % 10);
     }
-    return largest_mag;
+    std::string res = "[";
+    res += generate_snail(seed, depth + 1);
+    res += ",";
+    res += generate_snail(seed, depth + 1);
+    res += "]";
+    return res;
 }
 
 int main()
 {
     const aoc::StopWatch stop_watch;
     {
-        Generator test_gen;
-
-        test_gen.parse_line("[[1,9],[8,5]]")->print();
+        aoc::assert_equal(Snail::parse("[[1,9],[8,5]]").to_string(), std::string("[[1,9],[8,5]]"));
 
-        test_gen.parse_line("[[[[1,3],[5,3]],[[1,3],[8,7]]],[[[4,9],[6,9]],[[8,2],[7,3]]]]")->print();
+        const std::string deep = "[[[[1,3],[5,3]],[[1,3],[8,7]]],[[[4,9],[6,9]],[[8,2],[7,3]]]]";
+        aoc::assert_equal(Snail::parse(deep).to_string(), deep);
 
-        test_gen.add(test_gen.parse_line("[1,2]"), test_gen.parse_line("[[3,4],5]"))->print();
+        aoc::assert_equal(addition(Snail::parse("[1,2]"), Snail::parse("[[3,4],5]")).to_string(),
+                          std::string("[[1,2],[[3,4],5]]"));
 
-        aoc::assert_equal(magnitude(test_gen.parse_line("[[9,1],[1,9]]")), 129ul);
-        aoc::assert_equal(magnitude(test_gen.parse_line("[[[[8,7],[7,7]],[[8,6],[7,7]]],[[[0,7],[6,6]],[8,7]]]")), 3488ul);
+        aoc::assert_equal(magnitude(Snail::parse("[[9,1],[1,9]]")), 129ul);
+        aoc::assert_equal(magnitude(Snail::parse("[[[[8,7],[7,7]],[[8,6],[7,7]]],[[[0,7],[6,6]],[8,7]]]")), 3488ul);
 
-        const auto test_split_snail = test_gen.parse_line("[[[[0,7],4],[1,[0,1]]],[1,1]]");
-        aoc::assert_equal(search_split(test_split_snail).has_value(), false);
-        aoc::assert_equal(test_gen.split(test_split_snail), false);
+        auto test_split_snail = Snail::parse("[[[[0,7],4],[1,[0,1]]],[1,1]]");
+        aoc::assert_equal(test_split_snail.split(), false);
 
-        const auto test_explode_snail = test_gen.parse_line("[[[[[4,3],4],4],[7,[[8,4],9]]],[1,1]]");
-        const auto exploding_snail = search_explode(test_explode_snail, 0ul);
-        aoc::assert_equal(exploding_snail.has_value(), true);
-        aoc::assert_equal(explode(test_explode_snail), true);
-        test_explode_snail->print();
+        auto test_explode_snail = Snail::parse("[[[[[4,3],4],4],[7,[[8,4],9]]],[1,1]]");
+        aoc::assert_equal(test_explode_snail.explode(), true);
+        aoc::assert_equal(test_explode_snail.to_string(), std::string("[[[[0,7],4],[7,[[8,4],9]]],[1,1]]"));
+        aoc::assert_equal(test_explode_snail.explode(), true);
+        aoc::assert_equal(test_explode_snail.to_string(), std::string("[[[[0,7],4],[15,[0,13]]],[1,1]]"));
+        aoc::assert_equal(test_explode_snail.explode(), false);
+        aoc::assert_equal(test_explode_snail.split(), true);
+        aoc::assert_equal(test_explode_snail.to_string(), std::string("[[[[0,7],4],[[7,8],[0,13]]],[1,1]]"));
 
-        const auto test_snail1 = addition(test_gen.parse_line("[[[[4,3],4],4],[7,[[8,4],9]]]"),
-                                          test_gen.parse_line("[1,1]"), test_gen);
-        test_snail1->print();
+        const auto test_snail1 = addition(Snail::parse("[[[[4,3],4],4],[7,[[8,4],9]]]"),
+                                          Snail::parse("[1,1]"));
+        aoc::assert_equal(test_snail1.to_string(), std::string("[[[[0,7],4],[[7,8],[6,0]]],[8,1]]"));
 
-        const auto test_snail2 = addition(test_gen.parse_line("[[[0,[4,5]],[0,0]],[[[4,5],[2,6]],[9,5]]]"),
-                                          test_gen.parse_line("[7,[[[3,7],[4,3]],[[6,3],[8,8]]]]"), test_gen);
-        test_snail2->print();
+        const auto test_snail2 = addition(Snail::parse("[[[0,[4,5]],[0,0]],[[[4,5],[2,6]],[9,5]]]"),
+                                          Snail::parse("[7,[[[3,7],[4,3]],[[6,3],[8,8]]]]"));
+        aoc::assert_equal(test_snail2.to_string(), std::string("[[[[4,0],[5,4]],[[7,7],[6,0]]],[[8,[7,7]],[[7,9],[5,0]]]]"));
 
         const auto lines = aoc::get_lines("test.txt");
         aoc::assert_equal(homework_p1(lines), 4140ul);
@@ -402,5 +339,23 @@ int main()
     const auto lines = aoc::get_lines("input.txt");
     aoc::assert_equal(homework_p1(lines), 3816ul); // part 1
     aoc::assert_equal(homework_p2(lines), 4819ul); // part 2
+
+    {
+        const auto best = largest_pair_sum(parse(lines), 3);
+        aoc::assert_equal(best.magnitude, 4819ul);
+        aoc::assert_equal(magnitude(addition(Snail::parse(lines[best.lhs]), Snail::parse(lines[best.rhs]))), 4819ul);
+        aoc::assert_equal(best.lhs == largest_pair_sum(parse(lines)).lhs, true);
+    }
+    {
+        uint64_t seed = 18;
+        std::vector<std::string> generated(2000);
+        ranges::generate(generated, [&seed]()
+                         { return generate_snail(seed); });
+        const auto snails = parse(generated);
+
+        const aoc::StopWatch watch;
+        const auto best = largest_pair_sum(snails, std::max(2u, std::thread::hardware_concurrency()));
+        aoc::print("2000 numbers, largest sum ", best.magnitude, " from ", best.lhs, " + ", best.rhs);
+    }
     return 0;
 }
@@ -1,5 +1,9 @@
 #include <algorithm>
 #include <iostream>
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <thread>
 #include <unordered_set>
 #include "aoc_library.hpp"
 
@@ -54,77 +58,124 @@ struct position_hash
     }
 };
 
-typedef std::function<Position(const Position &)> Rotation;
+typedef std::array<std::array<int32_t, 3>, 3> Rotation;
 
-std::vector<Rotation> orientations()
+// The 24 proper rotations of the axes, each row picking one (possibly negated)
+// input axis.
+inline constexpr std::array<Rotation, 24> rotations = {{
+    // facing x
+    {{{1, 0, 0}, {0, 1, 0}, {0, 0, 1}}},   // y is up
+    {{{1, 0, 0}, {0, -1, 0}, {0, 0, -1}}}, // -y is up
+    {{{1, 0, 0}, {0, 0, -1}, {0, 1, 0}}},  // z is up
+    {{{1, 0, 0}, {0, 0, 1}, {0, -1, 0}}},  // -z is up
+
+    // facing -x
+    {{{-1, 0, 0}, {0, 1, 0}, {0, 0, -1}}}, // y is up
+    {{{-1, 0, 0}, {0, -1, 0}, {0, 0, 1}}}, // -y is up
+    {{{-1, 0, 0}, {0, 0, 1}, {0, 1, 0}}},  // z is up
+    {{{-1, 0, 0}, {0, 0, -1}, {0, -1, 0}}}, // -z is up
+
+    // facing y
+    {{{0, 1, 0}, {1, 0, 0}, {0, 0, -1}}},  // x is up
+    {{{0, -1, 0}, {1, 0, 0}, {0, 0, 1}}},  // -x is up
+    {{{0, 0, 1}, {1, 0, 0}, {0, 1, 0}}},   // z is up
+    {{{0, 0, -1}, {1, 0, 0}, {0, -1, 0}}}, // -z is up
+
+    // facing -y
+    {{{0, 1, 0}, {-1, 0, 0}, {0, 0, 1}}},   // x is up
+    {{{0, -1, 0}, {-1, 0, 0}, {0, 0, -1}}}, // -x is up
+    {{{0, 0, -1}, {-1, 0, 0}, {0, 1, 0}}},  // z is up
+    {{{0, 0, 1}, {-1, 0, 0}, {0, -1, 0}}},  // -z is up
+
+    // facing z
+    {{{0, 1, 0}, {0, 0, 1}, {1, 0, 0}}},   // x is up
+    {{{0, -1, 0}, {0, 0, -1}, {1, 0, 0}}}, // -x is up
+    {{{0, 0, -1}, {0, 1, 0}, {1, 0, 0}}},  // y is up
+    {{{0, 0, 1}, {0, -1, 0}, {1, 0, 0}}},  // -y is up
+
+    // facing -z
+    {{{0, 1, 0}, {0, 0, -1}, {-1, 0, 0}}},  // x is up
+    {{{0, -1, 0}, {0, 0, 1}, {-1, 0, 0}}},  // -x is up
+    {{{0, 0, 1}, {0, 1, 0}, {-1, 0, 0}}},   // y is up
+    {{{0, 0, -1}, {0, -1, 0}, {-1, 0, 0}}}, // -y is up
+}};
+
+constexpr int32_t determinant(const Rotation &r)
+{
+    return r[0][0] * (r[1][1] * r[2][2] - r[1][2] * r[2][1]) -
+           r[0][1] * (r[1][0] * r[2][2] - r[1][2] * r[2][0]) +
+           r[0][2] * (r[1][0] * r[2][1] - r[1][1] * r[2][0]);
+}
+
+static_assert(ranges::all_of(rotations, [](const auto &r)
+                             { return determinant(r) == 1; }));
+static_assert(ranges::none_of(rotations, [](const auto &r)
+                              { return ranges::count(rotations, r) != 1; }));
+
+constexpr Position rotate(const Rotation &r, const Position &p)
+{
+    return {r[0][0] * p.x + r[0][1] * p.y + r[0][2] * p.z,
+            r[1][0] * p.x + r[1][1] * p.y + r[1][2] * p.z,
+            r[2][0] * p.x + r[2][1] * p.y + r[2][2] * p.z};
+}
+
+// Beacons of one scanner as separate coordinate arrays.
+struct BeaconCloud
+{
+    std::vector<int32_t> x_;
+    std::vector<int32_t> y_;
+    std::vector<int32_t> z_;
+
+    uint64_t size() const
+    {
+        return x_.size();
+    }
+
+    void resize(uint64_t size)
+    {
+        x_.resize(size);
+        y_.resize(size);
+        z_.resize(size);
+    }
+
+    void push_back(const Position &p)
+    {
+        x_.push_back(p.x);
+        y_.push_back(p.y);
+        z_.push_back(p.z);
+    }
+
+    Position at(uint64_t i) const
+    {
+        return {x_[i], y_[i], z_[i]};
+    }
+};
+
+// out = r * in + t for a whole cloud. Each output axis is one loop over
+// contiguous int32 arrays, which the compiler turns into SIMD code.
+inline void transform(const BeaconCloud &in, const Rotation &r, const Position &t, BeaconCloud &out)
 {
-    return {
-        // facing x
-        [](const Position &p) -> Position
-        { return {p.x, p.y, p.z}; }, // facing x, y is up
-        [](const Position &p) -> Position
-        { return {p.x, -p.y, -p.z}; }, // facing x, -y is up
-        [](const Position &p) -> Position
-        { return {p.x, -p.z, p.y}; }, // facing x, z is up
-        [](const Position &p) -> Position
-        { return {p.x, p.z, -p.y}; }, // facing x, -z is up
-
-        // facing -x
-        [](const Position &p) -> Position
-        { return {-p.x, p.y, -p.z}; }, // facing -x, y is up
-        [](const Position &p) -> Position
-        { return {-p.x, -p.y, p.z}; }, // facing -x, -y is up
-        [](const Position &p) -> Position
-        { return {-p.x, p.z, p.y}; }, // facing -x, z is up
-        [](const Position &p) -> Position
-        { return {-p.x, -p.z, -p.y}; }, // facing -x, -z is up
-
-        // facing y
-        [](const Position &p) -> Position
-        { return {p.y, p.x, -p.z}; }, // x is up
-        [](const Position &p) -> Position
-        { return {-p.y, p.x, p.z}; }, // -x is up
-        [](const Position &p) -> Position
-        { return {p.z, p.x, p.y}; }, // z is up
-        [](const Position &p) -> Position
-        { return {-p.z, p.x, -p.y}; }, // -z is up
-
-        // facing -y
-        [](const Position &p) -> Position
-        { return {p.y, -p.x, p.z}; }, // x is up
-        [](const Position &p) -> Position
-        { return {-p.y, -p.x, -p.z}; }, // -x is up
-        [](const Position &p) -> Position
-        { return {-p.z, -p.x, p.y}; }, // z is up
-        [](const Position &p) -> Position
-        { return {p.z, -p.x, -p.y}; }, // -z is up
-
-        // facing z
-        [](const Position &p) -> Position
-        { return {p.y, p.z, p.x}; }, // x is up
-        [](const Position &p) -> Position
-        { return {-p.y, -p.z, p.x}; }, // -x is up
-        [](const Position &p) -> Position
-        { return {-p.z, p.y, p.x}; }, // y is up
-        [](const Position &p) -> Position
-        { return {p.z, -p.y, p.x}; }, // -y is up
-
-        // facing -z
-        [](const Position &p) -> Position
-        { return {p.y, -p.z, -p.x}; }, // x is up
-        [](const Position &p) -> Position
-        { return {-p.y, p.z, -p.x}; }, // -x is up
-        [](const Position &p) -> Position
-        { return {p.z, p.y, -p.x}; }, // y is up
-        [](const Position &p) -> Position
-        { return {-p.z, -p.y, -p.x}; }, // -y is up
+    const auto n = in.size();
+    out.resize(n);
+    const int32_t *__restrict x = in.x_.data();
+    const int32_t *__restrict y = in.y_.data();
+    const int32_t *__restrict z = in.z_.data();
+    const auto axis = [&](const std::array<int32_t, 3> &row, int32_t offset, int32_t *__restrict res)
+    {
+        for (uint64_t i = 0; i < n; i++)
+        {
+            res[i] = row[0] * x[i] + row[1] * y[i] + row[2] * z[i] + offset;
+        }
     };
+    axis(r[0], t.x, out.x_.data());
+    axis(r[1], t.y, out.y_.data());
+    axis(r[2], t.z, out.z_.data());
 }
 
 struct Scanner
 {
     std::string id_;
-    std::vector<std::vector<Position>> beacons_;
+    BeaconCloud beacons_;
     bool locked_ = false;
     Position relative_scanner0_;
     std::unordered_set<Position, position_hash> locked_set_;
@@ -133,70 +184,104 @@ struct Scanner
     {
         locked_ = true;
         relative_scanner0_ = relative_scanner0;
-        for (const auto &beacon : beacons_)
+        BeaconCloud rotated;
+        transform(beacons_, rotations[locked_orientation], {0, 0, 0}, rotated);
+        for (uint64_t i = 0; i < rotated.size(); i++)
         {
-            locked_set_.insert(beacon[locked_orientation]);
+            locked_set_.insert(rotated.at(i));
         }
     }
 
-    bool overlaps(Scanner &sc, std::unordered_set<Position, position_hash> &list_of_global_beacons)
+    // Orientation of `sc` and its position relative to this scanner, if at
+    // least 12 of its beacons land on beacons of this (locked) scanner.
+    std::optional<std::pair<uint64_t, Position>> find_overlap(const Scanner &sc) const
     {
-        // for each orientation in input
-        const auto locked = locked_set_;
+        BeaconCloud rotated;
         for (uint64_t orientation = 0; orientation < 24ul; orientation++)
         {
-            // for each position in input
-            // for each position in this
-            for (const auto &beacon_variations : sc.beacons_)
+            transform(sc.beacons_, rotations[orientation], {0, 0, 0}, rotated);
+            for (uint64_t i = 0; i < rotated.size(); i++)
             {
-                const auto &beacon = beacon_variations.at(orientation);
-                for (const auto &locked_beacon : locked)
+                const auto beacon = rotated.at(i);
+                for (const auto &locked_beacon : locked_set_)
                 {
-                    // translate to match
-                    Position translation = locked_beacon - beacon;
-                    // check if 12 others match with this translation
-                    std::unordered_set<Position, position_hash> matched;
-                    for (uint64_t i = 0; i < sc.beacons_.size(); i++)
+                    const Position translation = locked_beacon - beacon;
+                    uint64_t matched = 0;
+                    for (uint64_t j = 0; j < rotated.size(); j++)
                     {
-                        const Position &without = sc.beacons_.at(i).at(orientation);
-                        const Position translated = without + translation;
-                        if (locked.contains(translated) &&
-                            !matched.contains(translated))
-                        {
-                            matched.insert(translated);
-                        }
+                        matched += locked_set_.contains(rotated.at(j) + translation);
                     }
-                    if (matched.size() >= 12ul)
+                    if (matched >= 12ul)
                     {
-                        // if yes, lock down orientation in this
-                        // save translated points in this orientation to a global map
-                        // return true
-                        const Position trans = relative_scanner0_ + translation;
-                        sc.lock(orientation, trans);
-
-                        // update global map
-                        for (uint64_t ig = 0; ig < sc.beacons_.size(); ig++)
-                        {
-                            const auto trans_to_glob = sc.beacons_[ig][orientation] + trans;
-                            if (!list_of_global_beacons.contains(trans_to_glob))
-                            {
-                                list_of_global_beacons.insert(trans_to_glob);
-                            }
-                        }
-
-                        return true;
+                        return std::make_pair(orientation, translation);
                     }
                 }
             }
         }
-        return false;
+        return std::nullopt;
+    }
+
+    template <typename BeaconSet>
+    void lock_into(Scanner &sc, uint64_t orientation, const Position &translation, BeaconSet &list_of_global_beacons) const
+    {
+        const Position trans = relative_scanner0_ + translation;
+        sc.lock(orientation, trans);
+        BeaconCloud global;
+        transform(sc.beacons_, rotations[orientation], trans, global);
+        for (uint64_t i = 0; i < global.size(); i++)
+        {
+            list_of_global_beacons.insert(global.at(i));
+        }
+    }
+
+    bool overlaps(Scanner &sc, std::unordered_set<Position, position_hash> &list_of_global_beacons) const
+    {
+        const auto overlap = find_overlap(sc);
+        if (!overlap)
+        {
+            return false;
+        }
+        lock_into(sc, overlap->first, overlap->second, list_of_global_beacons);
+        return true;
     }
 };
 
-std::vector<Scanner> parse(const std::vector<std::string> &input)
+// Beacon positions spread over mutex-guarded shards by hash, so concurrent
+// inserts rarely wait on each other.
+class ShardedPositionSet
 {
-    const auto orients = orientations();
+public:
+    void insert(const Position &pos)
+    {
+        auto &shard = shards_[position_hash()(pos) % shard_count];
+        const std::lock_guard lock(shard.mutex);
+        shard.set.insert(pos);
+    }
 
+    uint64_t size() const
+    {
+        uint64_t res = 0;
+        for (const auto &shard : shards_)
+        {
+            res += shard.set.size();
+        }
+        return res;
+    }
+
+private:
+    static constexpr uint64_t shard_count = 64;
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_set<Position, position_hash> set;
+    };
+
+    std::array<Shard, shard_count> shards_;
+};
+
+std::vector<Scanner> parse(const std::vector<std::string> &input)
+{
     std::vector<Scanner> res;
     auto start = input.begin();
     while (true)
@@ -209,17 +294,11 @@ std::vector<Scanner> parse(const std::vector<std::string> &input)
         for (auto it = start + 1; it != end; it++)
         {
             const auto splitted = aoc::split(*it, ",");
-            Position p = {
+            sc.beacons_.push_back({
                 std::stoll(splitted[0]),
                 std::stoll(splitted[1]),
                 std::stoll(splitted[2]),
-            };
-            std::vector<Position> pos_options;
-            for (const auto &ori : orients)
-            {
-                pos_options.push_back(ori(p));
-            }
-            sc.beacons_.push_back(pos_options);
+            });
         }
         res.push_back(sc);
 
@@ -232,14 +311,324 @@ std::vector<Scanner> parse(const std::vector<std::string> &input)
     return res;
 }
 
+// Sorted absolute coordinate differences of a beacon pair. These survive
+// every rotation and translation, so scanners that see the same beacons share
+// fingerprints no matter how they are oriented.
+inline uint64_t fingerprint(const Position &a, const Position &b)
+{
+    std::array<uint64_t, 3> d = {static_cast<uint64_t>(std::abs(a.x - b.x)),
+                                 static_cast<uint64_t>(std::abs(a.y - b.y)),
+                                 static_cast<uint64_t>(std::abs(a.z - b.z))};
+    ranges::sort(d);
+    return (d[0] << 42) | (d[1] << 21) | d[2];
+}
+
+struct PairPrint
+{
+    uint64_t key;
+    uint32_t a;
+    uint32_t b;
+
+    auto operator<=>(const PairPrint &) const = default;
+};
+
+// Aligns scanners by breadth first search over the graph of scanner pairs
+// sharing enough fingerprints for 12 common beacons. The orientation search
+// only runs for those pairs, seeded with a matching beacon pair.
+class AlignmentEngine
+{
+public:
+    static constexpr uint64_t min_common_beacons = 12;
+    static constexpr uint64_t min_common_prints = min_common_beacons * (min_common_beacons - 1) / 2;
+
+    AlignmentEngine(const std::vector<Scanner> &scanners)
+        : scanners_(scanners),
+          prints_(scanners.size()),
+          global_(scanners.size()),
+          positions_(scanners.size())
+    {
+        for (uint64_t s = 0; s < scanners.size(); s++)
+        {
+            const auto &beacons = scanners[s].beacons_;
+            for (uint32_t a = 0; a < beacons.size(); a++)
+            {
+                for (uint32_t b = a + 1; b < beacons.size(); b++)
+                {
+                    prints_[s].push_back({fingerprint(beacons.at(a), beacons.at(b)), a, b});
+                }
+            }
+            ranges::sort(prints_[s]);
+        }
+    }
+
+    uint64_t shared_prints(uint64_t lhs, uint64_t rhs) const
+    {
+        uint64_t res = 0;
+        merge(lhs, rhs, [&res](const auto &, const auto &)
+              { res++; });
+        return res;
+    }
+
+    bool align()
+    {
+        const auto overlapping = overlap_graph();
+        std::vector<bool> aligned(scanners_.size(), false);
+        std::vector<uint64_t> queue = {0};
+        aligned[0] = true;
+        place(0, 0, {0, 0, 0});
+        for (uint64_t head = 0; head < queue.size(); head++)
+        {
+            const auto from = queue[head];
+            for (const auto to : overlapping[from])
+            {
+                if (!aligned[to] && try_align(from, to))
+                {
+                    aligned[to] = true;
+                    queue.push_back(to);
+                }
+            }
+        }
+        return queue.size() == scanners_.size();
+    }
+
+    uint64_t beacon_count() const
+    {
+        std::vector<Position> all;
+        for (const auto &beacons : global_)
+        {
+            all.insert(all.end(), beacons.begin(), beacons.end());
+        }
+        ranges::sort(all);
+        return std::unique(all.begin(), all.end()) - all.begin();
+    }
+
+    uint64_t largest_manhattan() const
+    {
+        uint64_t res = 0;
+        for (const auto &a : positions_)
+        {
+            for (const auto &b : positions_)
+            {
+                res = std::max(res, a.manhattan(b));
+            }
+        }
+        return res;
+    }
+
+    const Position &position(uint64_t scanner) const
+    {
+        return positions_[scanner];
+    }
+
+private:
+    // Every fingerprint goes into one sorted index; a run of equal keys adds
+    // one shared print to each pair of scanners in the run.
+    std::vector<std::vector<uint64_t>> overlap_graph() const
+    {
+        const auto n = scanners_.size();
+        std::vector<std::pair<uint64_t, uint32_t>> index;
+        for (uint32_t s = 0; s < n; s++)
+        {
+            for (const auto &print : prints_[s])
+            {
+                index.push_back({print.key, s});
+            }
+        }
+        ranges::sort(index);
+
+        std::vector<uint32_t> shared(n * n, 0);
+        for (uint64_t first = 0, last = 0; first < index.size(); first = last)
+        {
+            while (last < index.size() && index[last].first == index[first].first)
+            {
+                last++;
+            }
+            for (auto i = first; i < last; i++)
+            {
+                for (auto j = i + 1; j < last; j++)
+                {
+                    if (index[i].second != index[j].second)
+                    {
+                        shared[index[i].second * n + index[j].second]++;
+                    }
+                }
+            }
+        }
+
+        std::vector<std::vector<uint64_t>> res(n);
+        for (uint64_t i = 0; i < n; i++)
+        {
+            for (uint64_t j = i + 1; j < n; j++)
+            {
+                if (shared[i * n + j] >= min_common_prints)
+                {
+                    res[i].push_back(j);
+                    res[j].push_back(i);
+                }
+            }
+        }
+        return res;
+    }
+
+    template <typename Callback>
+    void merge(uint64_t lhs, uint64_t rhs, Callback callback) const
+    {
+        const auto &l = prints_[lhs];
+        const auto &r = prints_[rhs];
+        for (uint64_t i = 0, j = 0; i < l.size() && j < r.size();)
+        {
+            if (l[i].key < r[j].key)
+            {
+                i++;
+            }
+            else if (r[j].key < l[i].key)
+            {
+                j++;
+            }
+            else
+            {
+                callback(l[i++], r[j++]);
+            }
+        }
+    }
+
+    std::vector<std::pair<PairPrint, PairPrint>> matching_prints(uint64_t lhs, uint64_t rhs) const
+    {
+        std::vector<std::pair<PairPrint, PairPrint>> res;
+        merge(lhs, rhs, [&res](const auto &l, const auto &r)
+              { res.push_back({l, r}); });
+        return res;
+    }
+
+    void place(uint64_t scanner, uint64_t orientation, const Position &translation)
+    {
+        positions_[scanner] = translation;
+        BeaconCloud cloud;
+        transform(scanners_[scanner].beacons_, rotations[orientation], translation, cloud);
+        global_[scanner].clear();
+        for (uint64_t i = 0; i < cloud.size(); i++)
+        {
+            global_[scanner].push_back(cloud.at(i));
+        }
+    }
+
+    bool try_align(uint64_t from, uint64_t to)
+    {
+        const auto &known = global_[from];
+        auto sorted_known = known;
+        ranges::sort(sorted_known);
+        const auto &beacons = scanners_[to].beacons_;
+        BeaconCloud moved;
+
+        for (const auto &[print_from, print_to] : matching_prints(from, to))
+        {
+            const auto delta = known[print_from.b] - known[print_from.a];
+            for (const auto &[first, second] : {std::pair{print_to.a, print_to.b}, std::pair{print_to.b, print_to.a}})
+            {
+                for (uint64_t orientation = 0; orientation < 24ul; orientation++)
+                {
+                    const auto &rotation = rotations[orientation];
+                    if (rotate(rotation, beacons.at(second) - beacons.at(first)) != delta)
+                    {
+                        continue;
+                    }
+                    const auto translation = known[print_from.a] - rotate(rotation, beacons.at(first));
+                    transform(beacons, rotation, translation, moved);
+                    uint64_t common = 0;
+                    for (uint64_t i = 0; i < moved.size(); i++)
+                    {
+                        common += ranges::binary_search(sorted_known, moved.at(i));
+                    }
+                    if (common >= min_common_beacons)
+                    {
+                        place(to, orientation, translation);
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    const std::vector<Scanner> &scanners_;
+    std::vector<std::vector<PairPrint>> prints_;
+    std::vector<std::vector<Position>> global_;
+    std::vector<Position> positions_;
+};
+
+// Scanners on a grid `spacing` apart, each seeing the beacons of a shared
+// random field within 1000 units, in one of the 24 orientations.
+std::vector<std::string> generate(uint64_t nx, uint64_t ny, uint64_t nz, int64_t spacing,
+                                  uint64_t beacons, uint64_t seed, std::vector<Position> &scanner_positions)
+{
+    const auto next = [&seed](int64_t lo, int64_t hi)
+    {
+        seed = seed * 6364136223846793005ul + 1442695040888963407ul;
+        return lo + static_cast<int64_t>((seed >> 20) % (hi - lo + 1));
+    };
+    const Position low = {-1000, -1000, -1000};
+    const Position high = {static_cast<int64_t>(nx - 1) * spacing + 1000,
+                           static_cast<int64_t>(ny - 1) * spacing + 1000,
+                           static_cast<int64_t>(nz - 1) * spacing + 1000};
+    std::vector<Position> field(beacons);
+    for (auto &beacon : field)
+    {
+        beacon = {next(low.x, high.x), next(low.y, high.y), next(low.z, high.z)};
+    }
+
+    std::vector<std::string> res;
+    scanner_positions.clear();
+    for (uint64_t i = 0; i < nx * ny * nz; i++)
+    {
+        const Position scanner = {static_cast<int64_t>(i % nx) * spacing,
+                                  static_cast<int64_t>(i / nx % ny) * spacing,
+                                  static_cast<int64_t>(i / nx / ny) * spacing};
+        scanner_positions.push_back(scanner);
+        const auto &rotation = rotations[i == 0 ? 0 : next(0, 23)];
+        if (i > 0)
+        {
+            res.push_back("");
+        }
+        res.push_back("--- scanner " + std::to_string(i) + " ---");
+        for (const auto &beacon : field)
+        {
+            const auto local = beacon - scanner;
+            if (std::abs(local.x) <= 1000 && std::abs(local.y) <= 1000 && std::abs(local.z) <= 1000)
+            {
+                const auto seen = rotate(rotation, local);
+                res.push_back(std::to_string(seen.x) + "," + std::to_string(seen.y) + "," + std::to_string(seen.z));
+            }
+        }
+    }
+    return res;
+}
+
+uint64_t largest_manhattan(const std::vector<Scanner> &scanners)
+{
+    uint64_t largest_manhattan = 0;
+    for (const auto &scanner1 : scanners)
+    {
+        for (const auto &scanner2 : scanners)
+        {
+            if (scanner1.id_ == scanner2.id_)
+            {
+                continue;
+            }
+            largest_manhattan = std::max(largest_manhattan,
+                                         scanner1.relative_scanner0_.manhattan(scanner2.relative_scanner0_));
+        }
+    }
+    return largest_manhattan;
+}
+
 std::pair<uint64_t, uint64_t> reduce(std::vector<Scanner> &scanners)
 {
     std::unordered_set<Position, position_hash> list_of_beacons;
     scanners[0].lock(0, {0, 0, 0});
 
-    for (const auto &beacon : scanners[0].beacons_)
+    for (uint64_t i = 0; i < scanners[0].beacons_.size(); i++)
     {
-        list_of_beacons.insert(beacon[0]);
+        list_of_beacons.insert(scanners[0].beacons_.at(i));
     }
 
     while (true)
@@ -267,20 +656,67 @@ std::pair<uint64_t, uint64_t> reduce(std::vector<Scanner> &scanners)
             break;
         }
     }
-    uint64_t largest_manhattan = 0;
-    for (const auto &scanner1 : scanners)
+    return {list_of_beacons.size(), largest_manhattan(scanners)};
+}
+
+// Every round tests each unlocked scanner against the scanners locked in the
+// previous round only; older locked scanners were already tried against it.
+// A worker that finds an overlap locks the scanner itself, which is safe as
+// no other worker reads unlocked scanners.
+std::pair<uint64_t, uint64_t> reduce_parallel(std::vector<Scanner> &scanners, unsigned threads)
+{
+    ShardedPositionSet list_of_beacons;
+    scanners[0].lock(0, {0, 0, 0});
+    for (uint64_t i = 0; i < scanners[0].beacons_.size(); i++)
     {
-        for (const auto &scanner2 : scanners)
+        list_of_beacons.insert(scanners[0].beacons_.at(i));
+    }
+
+    std::vector<uint64_t> frontier = {0};
+    while (!frontier.empty())
+    {
+        std::vector<uint64_t> unlocked;
+        for (uint64_t i = 0; i < scanners.size(); i++)
         {
-            if (scanner1.id_ == scanner2.id_)
+            if (!scanners[i].locked_)
             {
-                continue;
+                unlocked.push_back(i);
             }
-            largest_manhattan = std::max(largest_manhattan,
-                                         scanner1.relative_scanner0_.manhattan(scanner2.relative_scanner0_));
         }
+
+        std::atomic<uint64_t> next = 0;
+        const auto work = [&]()
+        {
+            for (uint64_t i = next++; i < unlocked.size(); i = next++)
+            {
+                auto &sc = scanners[unlocked[i]];
+                for (const auto f : frontier)
+                {
+                    const auto overlap = scanners[f].find_overlap(sc);
+                    if (overlap)
+                    {
+                        scanners[f].lock_into(sc, overlap->first, overlap->second, list_of_beacons);
+                        break;
+                    }
+                }
+            }
+        };
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; t++)
+        {
+            workers.emplace_back(work);
+        }
+        work();
+        ranges::for_each(workers, [](auto &worker)
+                         { worker.join(); });
+
+        frontier.clear();
+        ranges::copy_if(unlocked, std::back_inserter(frontier), [&scanners](const auto i)
+                        { return scanners[i].locked_; });
     }
-    return {list_of_beacons.size(), largest_manhattan};
+    assert(ranges::all_of(scanners, [](const auto &sc)
+                          { return sc.locked_; }));
+    return {list_of_beacons.size(), largest_manhattan(scanners)};
 }
 
 int main()
@@ -300,10 +736,64 @@ int main()
         aoc::assert_equal(manhattan, 3621ul);
     }
 
+    {
+        const auto parsed = parse(aoc::get_lines("test.txt"));
+        AlignmentEngine engine(parsed);
+        aoc::assert_equal(engine.shared_prints(0, 1) >= AlignmentEngine::min_common_prints, true);
+        aoc::assert_equal(engine.align(), true);
+        aoc::assert_equal(engine.position(1) == Position{68, -1246, -43}, true);
+        aoc::assert_equal(engine.beacon_count(), 79ul);
+        aoc::assert_equal(engine.largest_manhattan(), 3621ul);
+    }
+
     auto parsed = parse(aoc::get_lines("input.txt"));
+    {
+        const aoc::StopWatch engine_watch;
+        AlignmentEngine engine(parsed);
+        aoc::assert_equal(engine.align(), true);
+        aoc::assert_equal(engine.beacon_count(), 342ul);
+        aoc::assert_equal(engine.largest_manhattan(), 9668ul);
+    }
     const auto [nr_beacons, manhattan] = reduce(parsed);
     aoc::assert_equal(nr_beacons, 342ul);
     aoc::assert_equal(manhattan, 9668ul);
+    {
+        const aoc::StopWatch parallel_watch;
+        auto fresh = parse(aoc::get_lines("input.txt"));
+        const auto [nr_beacons, manhattan] = reduce_parallel(fresh, std::max(2u, std::thread::hardware_concurrency()));
+        aoc::assert_equal(nr_beacons, 342ul);
+        aoc::assert_equal(manhattan, 9668ul);
+    }
+
+    {
+        std::vector<Position> positions;
+        const auto generated = parse(generate(10, 10, 2, 1000, 2500, 19, positions));
+        const aoc::StopWatch generated_watch;
+        AlignmentEngine engine(generated);
+        aoc::assert_equal(engine.align(), true);
+        for (uint64_t i = 0; i < positions.size(); i++)
+        {
+            aoc::assert_equal(engine.position(i) == positions[i], true);
+        }
+        aoc::print(generated.size(), " scanners, ", engine.beacon_count(), " beacons");
+    }
+    {
+        std::vector<Position> positions;
+        // A dense cluster: every scanner overlaps scanner 0, so the first
+        // round holds all the work as independent tasks.
+        const auto lines = generate(15, 14, 1, 20, 30, 40, positions);
+        for (const unsigned threads : {1u, std::max(2u, std::thread::hardware_concurrency())})
+        {
+            auto generated = parse(lines);
+            const aoc::StopWatch generated_watch;
+            const auto [nr_beacons, manhattan] = reduce_parallel(generated, threads);
+            for (uint64_t i = 0; i < positions.size(); i++)
+            {
+                aoc::assert_equal(generated[i].relative_scanner0_ == positions[i], true);
+            }
+            aoc::print(generated.size(), " scanners brute force on ", threads, " threads, ", nr_beacons, " beacons");
+        }
+    }
 
     return 0;
 }
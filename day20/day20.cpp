@@ -1,141 +1,257 @@
-#include <unordered_set>
+#include <barrier>
+#include <bit>
+#include <optional>
+#include <thread>
 #include "aoc_library.hpp"
 
 namespace ranges = std::ranges;
 
-struct Point
-{
-    int64_t x;
-    int64_t y;
-
-    auto operator<=>(const Point &) const = default;
-
-    Point operator+(const Point &rhs) const
-    {
-        return {
-            x + rhs.x,
-            y + rhs.y};
-    }
-
-    Point operator-(const Point &rhs) const
-    {
-        return {
-            x - rhs.x,
-            y - rhs.y};
-    }
-
-    friend std::ostream &operator<<(std::ostream &stream, const Point &p)
-    {
-        stream << "{" << p.x << ", " << p.y << "}";
-        return stream;
-    };
-};
-
-struct point_hash
-{
-    std::size_t operator()(const Point &pos) const
-    {
-        return (pos.x * 0x1f1f1f1f) ^ pos.y;
-    }
-};
-
+// The image as rows of packed bits, covering only the part that can differ
+// from the infinite background. Every step grows it by one pixel per side,
+// and the background colour itself is tracked separately.
 class Trench
 {
 public:
     Trench(const std::vector<std::string> &input)
+        : width_(input[2].size()),
+          height_(input.size() - 2),
+          words_per_row_((width_ + 63) / 64),
+          bits_(height_ * words_per_row_, 0)
     {
-        image_enh_alg_ = input[0];
-        for (int64_t y = 0; const auto &line : input | ranges::views::drop(2))
+        for (uint64_t i = 0; const auto c : input[0])
         {
-            for (int64_t x = 0; const auto c : line)
+            image_enh_alg_[i++] = c == '#';
+        }
+        // Four neighbouring output pixels read six pixels from each of three
+        // rows, leftmost lowest, and the table holds all four results at once.
+        // The algorithm itself reads each row's three pixels leftmost highest.
+        const auto reverse = [](uint64_t bits)
+        { return ((bits & 1) << 2) | (bits & 2) | ((bits >> 2) & 1); };
+        quads_.assign(1 << 18, 0);
+        for (uint64_t i = 0; i < quads_.size(); i++)
+        {
+            for (uint64_t k = 0; k < 4; k++)
+            {
+                const uint64_t index = (reverse(i >> (12 + k)) << 6) | (reverse(i >> (6 + k)) << 3) | reverse(i >> k);
+                quads_[i] |= image_enh_alg_[index] << k;
+            }
+        }
+        for (uint64_t y = 0; const auto &line : input | ranges::views::drop(2))
+        {
+            for (uint64_t x = 0; const auto c : line)
             {
                 if (c == '#')
                 {
-                    map_.insert({x, y});
+                    bits_[y * words_per_row_ + x / 64] |= 1ul << (x % 64);
                 }
                 x++;
             }
             y++;
         }
-        smallest_ = {0, 0};
-        largest_ = {(int64_t)input[2].size(), (int64_t)input.size() - 2};
     }
 
-    void enhance(uint64_t times = 2)
+    // The workers are started once per call and meet at a barrier after
+    // every step; its completion step swaps the buffers and pads the next
+    // input while all workers wait.
+    void enhance(uint64_t times = 2, unsigned threads = 1)
     {
-        for (uint64_t i = steps_; i < steps_ + times; i++)
+        if (times == 0)
         {
-            const bool even = i % 2 == 0;
-
-            Point new_smallest = {std::numeric_limits<int64_t>::max(), std::numeric_limits<int64_t>::max()};
-            Point new_largest = {std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::min()};
-            smallest_ = smallest_ - extend_with_;
-            largest_ = largest_ + extend_with_;
+            return;
+        }
+        threads = std::max(threads, 1u);
+        uint64_t done = 0;
+        prepare_step();
+        std::barrier sync(threads, [this, &done, times]() noexcept
+                          {
+                              finish_step();
+                              if (++done < times)
+                              {
+                                  prepare_step();
+                              } });
 
-            for (int64_t x = smallest_.x; x <= largest_.x; x++)
+        const auto work = [this, &sync, times, threads](unsigned t)
+        {
+            for (uint64_t i = 0; i < times; i++)
             {
-                for (int64_t y = smallest_.y; y <= largest_.y; y++)
-                {
-                    Point p = {x, y};
-                    for (uint64_t i = 0; const auto &trans : square3x3_)
-                    {
-                        if (map_.contains(p + trans))
-                        {
-                            bin_str_[i++] = even ? '1' : '0';
-                        }
-                        else
-                        {
-                            bin_str_[i++] = even ? '0' : '1';
-                        }
-                    }
-                    const char cmp_for_insert = even ? '.' : '#';
-                    const uint64_t index = std::stoul(bin_str_, nullptr, 2);
-                    if (image_enh_alg_[index] == cmp_for_insert)
-                    {
-                        tmp_.insert(p);
-                        new_smallest = {std::min(new_smallest.x, p.x), std::min(new_smallest.y, p.y)};
-                        new_largest = {std::max(new_largest.x, p.x), std::max(new_largest.y, p.y)};
-                    }
-                }
+                const uint64_t height = height_ + 2;
+                const uint64_t band = (height + threads - 1) / threads;
+                const uint64_t first = std::min(t * band, height);
+                enhance_rows(first, std::min(first + band, height), width_ + 2, (width_ + 2 + 63) / 64);
+                sync.arrive_and_wait();
             }
-            map_ = tmp_;
-            tmp_.clear();
-            smallest_ = new_smallest;
-            largest_ = new_largest;
+        };
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; t++)
+        {
+            workers.emplace_back(work, t);
         }
+        work(0);
+        ranges::for_each(workers, [](auto &worker)
+                         { worker.join(); });
         steps_ += times;
     }
 
-    void print()
+    void print() const
     {
-        std::vector<std::vector<char>> pmap =
-            std::vector<std::vector<char>>(largest_.y + 1 - smallest_.y,
-                                           std::vector<char>(largest_.x + 1 - smallest_.x, '.'));
-        for (const auto &p : map_)
+        std::vector<std::vector<char>> pmap(height_, std::vector<char>(width_, '.'));
+        for (uint64_t y = 0; y < height_; y++)
         {
-            pmap.at(p.y - smallest_.y).at(p.x - smallest_.y) = '#';
+            for (uint64_t x = 0; x < width_; x++)
+            {
+                if (pixel(row(y), x))
+                {
+                    pmap[y][x] = '#';
+                }
+            }
         }
         aoc::print(pmap);
     }
 
+    // Pixels that differ from the background.
     uint64_t count() const
     {
-        return map_.size();
+        uint64_t lit = 0;
+        for (const auto word : bits_)
+        {
+            lit += std::popcount(word);
+        }
+        return background_ ? width_ * height_ - lit : lit;
+    }
+
+    // Empty while the infinite background is lit.
+    std::optional<uint64_t> lit() const
+    {
+        if (background_)
+        {
+            return std::nullopt;
+        }
+        return count();
     }
 
+    uint64_t width() const { return width_; }
+    uint64_t height() const { return height_; }
+    uint64_t pixels_processed() const { return pixels_processed_; }
+
 private:
+    const uint64_t *row(int64_t y) const
+    {
+        return y < 0 || y >= static_cast<int64_t>(height_) ? nullptr : &bits_[y * words_per_row_];
+    }
+
+    uint64_t pixel(const uint64_t *row, int64_t x) const
+    {
+        if (!row || x < 0 || x >= static_cast<int64_t>(width_))
+        {
+            return background_;
+        }
+        return (row[x / 64] >> (x % 64)) & 1;
+    }
+
+    // Output pixel (x, y) is centred on input pixel (x - 1, y - 1). A whole
+    // output word reads 66 bits of each of three padded input rows and fills
+    // itself four pixels per table lookup. Rows are independent, so any row
+    // range can run on its own thread.
+    void enhance_rows(uint64_t first, uint64_t last, uint64_t width, uint64_t words_per_row)
+    {
+        const uint64_t stride = words_per_row_ + 2;
+        const uint64_t tail = width % 64 ? (1ul << (width % 64)) - 1 : ~0ul;
+
+        for (uint64_t y = first; y < last; y++)
+        {
+            const std::array<const uint64_t *, 3> rows = {&padded_[y * stride],
+                                                          &padded_[(y + 1) * stride],
+                                                          &padded_[(y + 2) * stride]};
+            uint64_t *out = &tmp_[y * words_per_row];
+            for (uint64_t word = 0; word < words_per_row; word++)
+            {
+                std::array<unsigned __int128, 3> spans;
+                for (uint64_t r = 0; r < 3; r++)
+                {
+                    spans[r] = (rows[r][word] >> 62) | (static_cast<unsigned __int128>(rows[r][word + 1]) << 2);
+                }
+                uint64_t res = 0;
+                for (uint64_t j = 0; j < 64; j += 4)
+                {
+                    const uint64_t index = ((static_cast<uint64_t>(spans[0] >> j) & 63) << 12) |
+                                           ((static_cast<uint64_t>(spans[1] >> j) & 63) << 6) |
+                                           (static_cast<uint64_t>(spans[2] >> j) & 63);
+                    res |= static_cast<uint64_t>(quads_[index]) << j;
+                }
+                out[word] = res;
+            }
+            out[words_per_row - 1] &= tail;
+        }
+    }
+
+    // Copies the image into rows with a background word on each side and two
+    // background rows above and below, so the kernel never has to check the
+    // edges.
+    void pad()
+    {
+        const uint64_t stride = words_per_row_ + 2;
+        const uint64_t fill = background_ ? ~0ul : 0;
+        padded_.assign((height_ + 4) * stride, fill);
+        for (uint64_t y = 0; y < height_; y++)
+        {
+            uint64_t *dest = &padded_[(y + 2) * stride + 1];
+            ranges::copy_n(row(y), words_per_row_, dest);
+            if (width_ % 64)
+            {
+                dest[words_per_row_ - 1] |= fill << (width_ % 64);
+            }
+        }
+    }
+
+    // A step reads bits_ through padded_ and writes tmp_, grown by one pixel
+    // per side; finishing it swaps the two buffers.
+    void prepare_step()
+    {
+        pad();
+        tmp_.assign((height_ + 2) * ((width_ + 2 + 63) / 64), 0);
+    }
+
+    void finish_step()
+    {
+        const uint64_t width = width_ + 2;
+        const uint64_t height = height_ + 2;
+        std::swap(bits_, tmp_);
+        width_ = width;
+        height_ = height;
+        words_per_row_ = (width + 63) / 64;
+        background_ = image_enh_alg_[background_ ? 511 : 0];
+        pixels_processed_ += width * height;
+    }
+
     uint64_t steps_ = 0;
-    std::string image_enh_alg_;
-    Point smallest_;
-    Point largest_;
-    std::unordered_set<Point, point_hash> map_;
-    std::unordered_set<Point, point_hash> tmp_;
-    std::vector<Point> square3x3_ = {
-        {-1, -1}, {0, -1}, {1, -1}, {-1, 0}, {0, 0}, {1, 0}, {-1, 1}, {0, 1}, {1, 1}};
-    std::string bin_str_ = "000000000";
-    Point extend_with_ = {1, 1};
+    uint64_t pixels_processed_ = 0;
+    uint64_t width_;
+    uint64_t height_;
+    uint64_t words_per_row_;
+    uint64_t background_ = 0;
+    std::array<uint8_t, 512> image_enh_alg_;
+    std::vector<uint8_t> quads_;
+    std::vector<uint64_t> bits_;
+    std::vector<uint64_t> padded_;
+    std::vector<uint64_t> tmp_;
 };
 
+std::vector<std::string> generate(const std::string &algorithm, uint64_t size, uint64_t seed)
+{
+    std::vector<std::string> res = {algorithm, ""};
+    for (uint64_t y = 0; y < size; y++)
+    {
+        std::string line(size, '.');
+        for (auto &c : line)
+        {
+            seed = seed * 6364136223846793005ul + 1442695040888963407ul;
+            c = (seed >> 40) % 2 ? '#' : '.';
+        }
+        res.push_back(line);
+    }
+    return res;
+}
+
 int main()
 {
     const aoc::StopWatch stop_watch;
@@ -154,5 +270,26 @@ int main()
     aoc::assert_equal(trench.count(), 5563ul); // part 1
     trench.enhance(48ul);
     aoc::assert_equal(trench.count(), 19743ul); // part 2
+    aoc::assert_equal(*trench.lit(), 19743ul);
+    trench.enhance(1ul);
+    aoc::assert_equal(trench.lit().has_value(), false);
+
+    {
+        Trench parallel(lines);
+        parallel.enhance(50ul, 3);
+        aoc::assert_equal(*parallel.lit(), 19743ul);
+    }
+    std::vector<uint64_t> lit;
+    for (const unsigned threads : {1u, std::max(2u, std::thread::hardware_concurrency())})
+    {
+        Trench generated(generate(lines[0], 200, 20));
+        const auto start = std::chrono::high_resolution_clock::now();
+        generated.enhance(500, threads);
+        const std::chrono::duration<double> seconds = std::chrono::high_resolution_clock::now() - start;
+        aoc::print("500 steps, ", generated.width(), "x", generated.height(), ", lit: ", *generated.lit(),
+                   ", ", threads, " threads: ", generated.pixels_processed() / seconds.count() / 1e6, " Mpixels/s");
+        lit.push_back(*generated.lit());
+    }
+    aoc::assert_equal(lit[0], lit[1]);
     return 0;
 }
@@ -1,5 +1,8 @@
+#include <map>
+#include <numeric>
 #include "aoc_library.hpp"
 
+namespace ranges = std::ranges;
 
 inline std::pair<uint64_t, uint64_t> step_player(uint64_t position, uint64_t score, uint64_t steps)
 {
@@ -7,84 +10,326 @@ inline std::pair<uint64_t, uint64_t> step_player(uint64_t position, uint64_t sco
     return { new_pos, score + new_pos };
 }
 
-struct Answer
+// Plays the deterministic die turn by turn, the reference for DeterministicGame.
+inline std::pair<uint64_t, uint64_t> play_deterministic(uint64_t player_pos, uint64_t opponent_pos, uint64_t threshold)
 {
-    uint64_t player_wins;
-    uint64_t opponent_wins;
+    std::array<std::pair<uint64_t, uint64_t>, 2> players = {{{player_pos, 0}, {opponent_pos, 0}}};
+    for (uint64_t turn = 0, die = 0;; turn++)
+    {
+        const uint64_t steps = die % 100 + (die + 1) % 100 + (die + 2) % 100 + 3;
+        die = (die + 3) % 100;
+        auto &[position, score] = players[turn % 2];
+        players[turn % 2] = step_player(position, score, steps);
+        if (players[turn % 2].second >= threshold)
+        {
+            return {players[(turn + 1) % 2].second, 3 * (turn + 1)};
+        }
+    }
+}
 
-    void operator+=(const Answer& rhs)
+struct DeterministicResult
+{
+    uint64_t losing_score;
+    uint64_t rolls;
+
+    unsigned __int128 product() const
     {
-        player_wins += rhs.player_wins;
-        opponent_wins += rhs.opponent_wins;
+        return static_cast<unsigned __int128>(losing_score) * rolls;
     }
 };
 
-struct Question
+// The die, the positions and whose turn it is all return together after a
+// fixed number of turns, so one simulated period gives every later score:
+// whole periods add a fixed amount, and within a period the scores are
+// sorted, which leaves a division and a binary search per player.
+class DeterministicGame
 {
-    uint64_t player_pos;
-    uint64_t player_score;
-    uint64_t opponent_pos;
-    uint64_t opponent_score;
+public:
+    DeterministicGame(uint64_t player_pos, uint64_t opponent_pos,
+                      uint64_t board = 10, uint64_t faces = 100, uint64_t rolls = 3)
+        : rolls_(rolls)
+    {
+        std::array<uint64_t, 2> positions = {player_pos - 1, opponent_pos - 1};
+        std::array<uint64_t, 2> scores = {0, 0};
+        uint64_t die = 0;
+        for (uint64_t turn = 0;; turn++)
+        {
+            uint64_t steps = 0;
+            for (uint64_t roll = 0; roll < rolls; roll++)
+            {
+                steps += die + 1;
+                die = (die + 1) % faces;
+            }
+            auto &position = positions[turn % 2];
+            position = (position + steps) % board;
+            scores[turn % 2] += position + 1;
+            prefix_[turn % 2].push_back(scores[turn % 2]);
+            if (turn % 2 == 1 && die == 0 &&
+                positions[0] == player_pos - 1 && positions[1] == opponent_pos - 1)
+            {
+                break;
+            }
+        }
+    }
+
+    DeterministicResult play(uint64_t threshold) const
+    {
+        const auto first = winning_turn(0, threshold);
+        const auto second = winning_turn(1, threshold);
+        const auto turn = std::min(first, second);
+        const uint64_t loser = first < second ? 1 : 0;
+        return {score_after(loser, (turn + 1 - loser) / 2), rolls_ * (turn + 1)};
+    }
 
-    auto operator<=>(const Question &) const = default;
+private:
+    // Score of a player after its own first turns.
+    uint64_t score_after(uint64_t player, uint64_t turns) const
+    {
+        const auto &prefix = prefix_[player];
+        const uint64_t periods = turns / prefix.size();
+        const uint64_t rest = turns % prefix.size();
+        return periods * prefix.back() + (rest ? prefix[rest - 1] : 0);
+    }
+
+    // Overall turn index on which a player first reaches the threshold.
+    uint64_t winning_turn(uint64_t player, uint64_t threshold) const
+    {
+        const auto &prefix = prefix_[player];
+        const uint64_t periods = (threshold - 1) / prefix.back();
+        const uint64_t own = ranges::lower_bound(prefix, threshold - periods * prefix.back()) - prefix.begin();
+        return 2 * (periods * prefix.size() + own) + player;
+    }
+
+    uint64_t rolls_;
+    std::array<std::vector<uint64_t>, 2> prefix_;
 };
 
-struct question_hash
+inline std::string to_string(unsigned __int128 value)
+{
+    std::string res;
+    do
+    {
+        res.push_back('0' + static_cast<char>(value % 10));
+        value /= 10;
+    } while (value != 0);
+    ranges::reverse(res);
+    return res;
+}
+
+template <typename Count>
+struct Answer
 {
-    std::size_t operator()(const Question &q) const
+    Count player_wins;
+    Count opponent_wins;
+
+    void operator+=(const Answer& rhs)
     {
-        return (q.player_pos << 48) + (q.player_score << 32) +
-               (q.opponent_pos << 16) + q.opponent_score;
+        player_wins += rhs.player_wins;
+        opponent_wins += rhs.opponent_wins;
     }
 };
 
-inline std::vector<uint64_t> all_universes()
+struct DiceRules
+{
+    uint64_t board = 10;
+    uint64_t faces = 3;
+    uint64_t rolls = 3;
+    uint64_t threshold = 21;
+};
+
+// Universes per roll sum, folded modulo the board size, since only the new
+// position matters to the game.
+inline std::vector<uint64_t> roll_ways(const DiceRules &rules)
 {
-    static const std::vector<uint64_t> res =
-        { 3, 4, 5, 4, 5, 6, 5, 6, 7, 4, 5, 6, 5, 6, 7, 6, 7, 8, 5, 6, 7, 6, 7, 8, 7, 8, 9 };
+    std::vector<uint64_t> sums = {1};
+    for (uint64_t roll = 0; roll < rules.rolls; roll++)
+    {
+        std::vector<uint64_t> next(sums.size() + rules.faces, 0);
+        for (uint64_t sum = 0; sum < sums.size(); sum++)
+        {
+            for (uint64_t face = 1; face <= rules.faces; face++)
+            {
+                next[sum + face] += sums[sum];
+            }
+        }
+        sums = std::move(next);
+    }
+    std::vector<uint64_t> res(rules.board, 0);
+    for (uint64_t sum = 0; sum < sums.size(); sum++)
+    {
+        res[sum % rules.board] += sums[sum];
+    }
     return res;
 }
 
-typedef std::unordered_map<Question, Answer, question_hash> SolutionMemo;
-
-Answer universe_wins(const Question& quest, SolutionMemo& solutions)
+// Wins for the player about to move, for every pair of starting positions.
+// States are filled bottom-up by descending total score: a move adds between
+// 1 and board points, so only the last board + 1 diagonals of the score table
+// are kept, each holding the whole position table per score.
+template <typename Count = uint64_t>
+class DiracDice
 {
-    if (solutions.contains(quest))
+public:
+    DiracDice(const DiceRules &rules)
+        : board_(rules.board),
+          start_(rules.board * rules.board)
+    {
+        // Floating point counts hold probabilities instead, which stay in
+        // range however long the game runs.
+        std::vector<Count> ways;
+        const auto exact = roll_ways(rules);
+        const Count universes = std::accumulate(exact.begin(), exact.end(), 0ul);
+        for (const auto way : exact)
+        {
+            ways.push_back(std::is_floating_point_v<Count> ? way / universes : way);
+        }
+        const uint64_t threshold = rules.threshold;
+        const uint64_t positions = board_ * board_;
+        const uint64_t layers = board_ + 1;
+        std::vector<Answer<Count>> table(layers * threshold * positions);
+        const auto at = [&](uint64_t total, uint64_t score) -> Answer<Count> *
+        { return &table[((total % layers) * threshold + score) * positions]; };
+
+        for (int64_t total = 2 * (threshold - 1); total >= 0; total--)
+        {
+            const uint64_t first = std::max<int64_t>(0, total - (threshold - 1));
+            const uint64_t last = std::min<uint64_t>(total, threshold - 1);
+            for (uint64_t score = first; score <= last; score++)
+            {
+                const uint64_t other = total - score;
+                Answer<Count> *answers = at(total, score);
+                std::fill_n(answers, positions, Answer<Count>{0, 0});
+                // Grouped by landing position, so each move reads one
+                // contiguous block of the next diagonal.
+                for (uint64_t np = 0; np < board_; np++)
+                {
+                    const bool won = score + np + 1 >= threshold;
+                    const Answer<Count> *children = won ? nullptr : at(total + np + 1, other);
+                    for (uint64_t p = 0; p < board_; p++)
+                    {
+                        const Count w = ways[(np + board_ - p) % board_];
+                        Answer<Count> *row = &answers[p * board_];
+                        for (uint64_t q = 0; q < board_; q++)
+                        {
+                            if (won)
+                            {
+                                row[q].player_wins += w;
+                            }
+                            else
+                            {
+                                const auto &child = children[q * board_ + np];
+                                row[q] += {w * child.opponent_wins, w * child.player_wins};
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        std::copy_n(at(0, 0), positions, start_.begin());
+    }
+
+    // Positions are 1-based, as on the puzzle's board.
+    Answer<Count> wins(uint64_t player_pos, uint64_t opponent_pos) const
     {
-        return solutions.at(quest);
+        return start_[(player_pos - 1) * board_ + opponent_pos - 1];
     }
 
-    Answer accumulated_wins = {0,0};
+private:
+    uint64_t board_;
+    std::vector<Answer<Count>> start_;
+};
 
-    for (const uint64_t steps : all_universes())
+// Reference for DiracDice: memoized recursion that tries every sequence of
+// rolls on its own, with 1-based positions as on the board.
+Answer<uint64_t> dirac_reference(const DiceRules &rules, uint64_t pos, uint64_t score,
+                                 uint64_t other_pos, uint64_t other_score,
+                                 std::map<std::array<uint64_t, 4>, Answer<uint64_t>> &memo)
+{
+    const std::array<uint64_t, 4> state = {pos, score, other_pos, other_score};
+    if (const auto found = memo.find(state); found != memo.end())
     {
-        const auto [player_pos, player_score] = step_player(quest.player_pos, quest.player_score, steps);
-        if (player_score >= 21)
+        return found->second;
+    }
+    uint64_t outcomes = 1;
+    for (uint64_t roll = 0; roll < rules.rolls; roll++)
+    {
+        outcomes *= rules.faces;
+    }
+    Answer<uint64_t> res = {0, 0};
+    for (uint64_t outcome = 0; outcome < outcomes; outcome++)
+    {
+        uint64_t steps = 0;
+        for (uint64_t rest = outcome, roll = 0; roll < rules.rolls; roll++, rest /= rules.faces)
         {
-            accumulated_wins += {1, 0};
+            steps += rest % rules.faces + 1;
         }
-        else {
-            const auto [opponent_wins, player_wins] = universe_wins(
-                {quest.opponent_pos, quest.opponent_score, player_pos, player_score}, solutions);
-            accumulated_wins += {player_wins, opponent_wins};
+        const uint64_t new_pos = (pos + steps - 1) % rules.board + 1;
+        if (score + new_pos >= rules.threshold)
+        {
+            res.player_wins++;
+            continue;
         }
+        const auto next = dirac_reference(rules, other_pos, other_score, new_pos, score + new_pos, memo);
+        res += {next.opponent_wins, next.player_wins};
     }
-    solutions.emplace(quest, accumulated_wins);
-    return accumulated_wins;
+    memo[state] = res;
+    return res;
 }
 
 int main()
 {
     const aoc::StopWatch stop_watch;
 
-    SolutionMemo solutions;
     {
-        const auto [p1_wins, p2_wins] = universe_wins({4, 0, 8, 0}, solutions);
-        aoc::assert_equal(std::max(p1_wins, p2_wins), 444356092776315ul); // test example
+        const DeterministicGame game(4, 8);
+        aoc::assert_equal(game.play(1000).losing_score, 745ul); // test example
+        aoc::assert_equal(game.play(1000).rolls, 993ul);
+        for (const uint64_t threshold : {1ul, 10ul, 21ul, 999ul, 4567ul, 123456ul, 9876543ul})
+        {
+            const auto [losing_score, rolls] = play_deterministic(4, 8, threshold);
+            aoc::assert_equal(game.play(threshold).losing_score, losing_score);
+            aoc::assert_equal(game.play(threshold).rolls, rolls);
+        }
+    }
+    {
+        const DeterministicGame game(8, 9);
+        const auto [losing_score, rolls] = play_deterministic(8, 9, 1000);
+        aoc::assert_equal(to_string(game.play(1000).product()), std::to_string(losing_score * rolls));
+        aoc::assert_equal(to_string(game.play(1000).product()), std::string("512442")); // part 1
+        const aoc::StopWatch watch;
+        aoc::print("threshold 1e18: ", to_string(game.play(1000000000000000000ul).product()));
+    }
+
+    const DiracDice dice(DiceRules{});
+    {
+        const auto [p1_wins, p2_wins] = dice.wins(4, 8);
+        aoc::assert_equal(p1_wins, 444356092776315ul); // test example
+        aoc::assert_equal(p2_wins, 341960390180808ul);
+        std::map<std::array<uint64_t, 4>, Answer<uint64_t>> memo;
+        const auto reference = dirac_reference(DiceRules{}, 4, 0, 8, 0, memo);
+        aoc::assert_equal(reference.player_wins, p1_wins);
+        aoc::assert_equal(reference.opponent_wins, p2_wins);
     }
 
-    const auto [p1_wins, p2_wins] = universe_wins({8, 0, 9, 0}, solutions);
+    const auto [p1_wins, p2_wins] = dice.wins(8, 9);
     aoc::assert_equal(std::max(p1_wins, p2_wins), 346642902541848ul); // part 2 solution
 
+    {
+        const DiracDice variant(DiceRules{7, 4, 2, 15});
+        const auto [v1_wins, v2_wins] = variant.wins(3, 5);
+        aoc::assert_equal(v1_wins, 84356353009620ul);
+        aoc::assert_equal(v2_wins, 81444074135281ul);
+        std::map<std::array<uint64_t, 4>, Answer<uint64_t>> memo;
+        const auto reference = dirac_reference(DiceRules{7, 4, 2, 15}, 3, 0, 5, 0, memo);
+        aoc::assert_equal(reference.player_wins, v1_wins);
+        aoc::assert_equal(reference.opponent_wins, v2_wins);
+    }
+    {
+        const aoc::StopWatch watch;
+        const DiracDice<double> large(DiceRules{10, 100, 3, 1000});
+        const auto [l1_wins, l2_wins] = large.wins(8, 9);
+        aoc::print("d100 x 3 to 1000, first player wins ", l1_wins / (l1_wins + l2_wins));
+    }
+
     return 0;
 }
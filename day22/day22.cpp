@@ -1,5 +1,6 @@
 #include <numeric>
 #include <algorithm>
+#include <optional>
 #include "aoc_library.hpp"
 
 namespace ranges = std::ranges;
@@ -11,15 +12,6 @@ struct Cube
     int64_t z;
 };
 
-inline Cube get_closest_point(const std::pair<Cube, Cube> &line, const Cube &cube)
-{
-    return {
-        .x=std::min(std::max(cube.x, line.first.x), line.second.x),
-        .y=std::min(std::max(cube.y, line.first.y), line.second.y),
-        .z=std::min(std::max(cube.z, line.first.z), line.second.z)
-    };
-}
-
 struct Cubeoid
 {
     int64_t x_min;
@@ -56,55 +48,65 @@ struct Cubeoid
         };
     }
 
-    std::vector<std::pair<Cube, Cube>> outer_lines() const
+    bool intersects(const Cubeoid &c) const
     {
-        return {
-            {{x_min, y_min, z_min}, {x_max, y_min, z_min}},
-            {{x_min, y_max, z_max}, {x_max, y_max, z_max}},
-            {{x_min, y_min, z_max}, {x_max, y_min, z_max}},
-            {{x_min, y_max, z_min}, {x_max, y_max, z_min}},
-
-            {{x_min, y_min, z_min}, {x_min, y_max, z_min}},
-            {{x_max, y_min, z_max}, {x_max, y_max, z_max}},
-            {{x_max, y_min, z_min}, {x_max, y_max, z_min}},
-            {{x_min, y_min, z_max}, {x_min, y_max, z_max}},
-
-            {{x_min, y_min, z_min}, {x_min, y_min, z_max}},
-            {{x_max, y_max, z_min}, {x_max, y_max, z_max}},
-            {{x_max, y_min, z_min}, {x_max, y_min, z_max}},
-            {{x_min, y_max, z_min}, {x_min, y_max, z_max}},
-        };
+        return x_min <= c.x_max && c.x_min <= x_max &&
+               y_min <= c.y_max && c.y_min <= y_max &&
+               z_min <= c.z_max && c.z_min <= z_max;
     }
 
-    Cube middle() const
+    // Only meaningful when the two intersect.
+    Cubeoid intersection(const Cubeoid &c) const
     {
-        return {(x_max - x_min) / 2 + x_min,
-                (y_max - y_min) / 2 + y_min,
-                (z_max - z_min) / 2 + z_min};
+        return {std::max(x_min, c.x_min), std::min(x_max, c.x_max),
+                std::max(y_min, c.y_min), std::min(y_max, c.y_max),
+                std::max(z_min, c.z_min), std::min(z_max, c.z_max)};
     }
 
-    bool intersected_by(const std::vector<std::pair<Cube, Cube>> &lines) const
+    // Half-open bounds along axis 0, 1 or 2.
+    std::pair<int64_t, int64_t> extent(uint64_t axis) const
     {
-        for (const auto &line : lines)
+        switch (axis)
         {
-            Cube closest = get_closest_point(line, middle());
-            if (is_cube_inside(closest))
-            {
-                return true;
-            }
+        case 0:
+            return {x_min, x_max + 1};
+        case 1:
+            return {y_min, y_max + 1};
+        default:
+            return {z_min, z_max + 1};
         }
-        return false;
     }
 
-    bool overlaps(const Cubeoid &c) const
+    Cubeoid with_extent(uint64_t axis, int64_t lo, int64_t hi) const
     {
-        return intersected_by(c.outer_lines()) || c.intersected_by(outer_lines());
+        Cubeoid res = *this;
+        auto [min, max] = axis == 0 ? std::tie(res.x_min, res.x_max)
+                          : axis == 1 ? std::tie(res.y_min, res.y_max)
+                                      : std::tie(res.z_min, res.z_max);
+        min = lo;
+        max = hi - 1;
+        return res;
     }
 
     uint64_t count() const
     {
         return (x_max - x_min + 1) * (y_max - y_min + 1) * (z_max - z_min + 1);
     }
+
+    bool operator==(const Cubeoid &) const = default;
+};
+
+struct cubeoid_hash
+{
+    std::size_t operator()(const Cubeoid &c) const
+    {
+        uint64_t res = 0;
+        for (const int64_t v : {c.x_min, c.x_max, c.y_min, c.y_max, c.z_min, c.z_max})
+        {
+            res = (res ^ static_cast<uint64_t>(v)) * 0x100000001b3ul;
+        }
+        return res;
+    }
 };
 
 inline std::vector<Cubeoid> split(const Cubeoid &c1, const Cubeoid &c2)
@@ -160,45 +162,195 @@ inline std::vector<Cubeoid> split(const Cubeoid &c1, const Cubeoid &c2)
     return res;
 }
 
-struct Space
+// The on-cubes as disjoint fragments, binned into a uniform grid of cells so
+// an insert only tests the fragments registered in the cells it covers.
+// Split fragments are marked dead and dropped from a cell's list the next
+// time a query walks it.
+class Space
 {
+public:
+    explicit Space(int64_t cell_size = 1 << 14)
+        : cell_size_(cell_size)
+    {
+    }
+
     void insert(const std::pair<bool, Cubeoid> &insert)
     {
         const auto [on, cubeoid] = insert;
 
-        std::vector<Cubeoid> to_split;
-        const auto [rem_f, rem_l] = ranges::remove_if(on_cubeoids, [&cubeoid, &to_split](const auto &c)
-                                                      {
-                                                          const bool overlaps = c.overlaps(cubeoid);
-                                                          if (overlaps)
-                                                          {
-                                                              to_split.push_back(c);
-                                                          }
-                                                          return overlaps;
-                                                      });
-        on_cubeoids.erase(rem_f, rem_l);
-        for (const auto &ts : to_split)
+        query_++;
+        std::vector<uint32_t> to_split;
+        for_each_cell(cubeoid, [&](const uint64_t key)
+                      {
+                          const auto cell = cells_.find(key);
+                          if (cell == cells_.end())
+                          {
+                              return;
+                          }
+                          auto &ids = cell->second;
+                          for (uint64_t i = 0; i < ids.size();)
+                          {
+                              const auto id = ids[i];
+                              if (!alive_[id])
+                              {
+                                  ids[i] = ids.back();
+                                  ids.pop_back();
+                                  continue;
+                              }
+                              if (visited_[id] != query_)
+                              {
+                                  visited_[id] = query_;
+                                  if (fragments_[id].intersects(cubeoid))
+                                  {
+                                      to_split.push_back(id);
+                                  }
+                              }
+                              i++;
+                          }
+                      });
+
+        for (const auto id : to_split)
         {
-            const auto splitted = split(ts, cubeoid);
-            on_cubeoids.insert(on_cubeoids.end(), splitted.begin(), splitted.end());
+            alive_[id] = false;
+            alive_count_--;
+            for (const auto &fragment : split(fragments_[id], cubeoid))
+            {
+                add(fragment);
+            }
         }
-
         if (on)
         {
-            on_cubeoids.push_back(cubeoid);
+            add(cubeoid);
         }
     }
 
     uint64_t count() const
     {
-        return std::accumulate(on_cubeoids.begin(), on_cubeoids.end(), 0ul, [](auto acc, const auto &cubeoid)
-                               { return acc + cubeoid.count(); });
+        uint64_t res = 0;
+        for (uint64_t id = 0; id < fragments_.size(); id++)
+        {
+            res += alive_[id] ? fragments_[id].count() : 0;
+        }
+        return res;
+    }
+
+    // On-cubes inside a window. A fragment shows up in every cell it covers,
+    // so its part inside the window is only counted in the cell holding that
+    // part's lowest corner. The window is first clipped to the bounding box
+    // of everything ever added, so it never reaches outside the cell grid,
+    // and windows still spanning more cells than are in use walk the used
+    // cells instead.
+    uint64_t count(const Cubeoid &query) const
+    {
+        if (!bounds_ || !bounds_->intersects(query))
+        {
+            return 0;
+        }
+        const auto window = bounds_->intersection(query);
+        uint64_t res = 0;
+        const auto visit = [&](uint64_t key, const std::vector<uint32_t> &ids)
+        {
+            for (const auto id : ids)
+            {
+                if (alive_[id] && fragments_[id].intersects(window))
+                {
+                    const auto part = fragments_[id].intersection(window);
+                    if (cell_key(part.x_min, part.y_min, part.z_min) == key)
+                    {
+                        res += part.count();
+                    }
+                }
+            }
+        };
+
+        const uint64_t cells = (cell(window.x_max) - cell(window.x_min) + 1) *
+                               (cell(window.y_max) - cell(window.y_min) + 1) *
+                               (cell(window.z_max) - cell(window.z_min) + 1);
+        if (cells > cells_.size())
+        {
+            for (const auto &[key, ids] : cells_)
+            {
+                visit(key, ids);
+            }
+            return res;
+        }
+        for_each_cell(window, [&](const uint64_t key)
+                      {
+                          const auto found = cells_.find(key);
+                          if (found != cells_.end())
+                          {
+                              visit(key, found->second);
+                          }
+                      });
+        return res;
+    }
+
+    uint64_t size() const
+    {
+        return alive_count_;
+    }
+
+private:
+    static constexpr int64_t cell_bias = 1 << 20;
+
+    uint64_t cell(int64_t v) const
+    {
+        const int64_t res = (v >= 0 ? v : v - cell_size_ + 1) / cell_size_ + cell_bias;
+        assert(res >= 0 && res < 2 * cell_bias);
+        return res;
     }
 
-    std::vector<Cubeoid> on_cubeoids;
+    uint64_t cell_key(int64_t x, int64_t y, int64_t z) const
+    {
+        return (cell(x) << 42) | (cell(y) << 21) | cell(z);
+    }
+
+    template <typename F>
+    void for_each_cell(const Cubeoid &c, F f) const
+    {
+        for (uint64_t x = cell(c.x_min); x <= cell(c.x_max); x++)
+        {
+            for (uint64_t y = cell(c.y_min); y <= cell(c.y_max); y++)
+            {
+                for (uint64_t z = cell(c.z_min); z <= cell(c.z_max); z++)
+                {
+                    f((x << 42) | (y << 21) | z);
+                }
+            }
+        }
+    }
+
+    void add(const Cubeoid &c)
+    {
+        const uint32_t id = fragments_.size();
+        fragments_.push_back(c);
+        alive_.push_back(true);
+        visited_.push_back(0);
+        alive_count_++;
+        if (!bounds_)
+        {
+            bounds_ = c;
+        }
+        bounds_ = Cubeoid{std::min(bounds_->x_min, c.x_min), std::max(bounds_->x_max, c.x_max),
+                          std::min(bounds_->y_min, c.y_min), std::max(bounds_->y_max, c.y_max),
+                          std::min(bounds_->z_min, c.z_min), std::max(bounds_->z_max, c.z_max)};
+        for_each_cell(c, [this, id](const uint64_t key)
+                      { cells_[key].push_back(id); });
+    }
+
+    int64_t cell_size_;
+    uint64_t query_ = 0;
+    uint64_t alive_count_ = 0;
+    std::optional<Cubeoid> bounds_;
+    std::vector<Cubeoid> fragments_;
+    std::vector<bool> alive_;
+    std::vector<uint64_t> visited_;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> cells_;
 };
 
-std::pair<bool, Cubeoid> parse_line(const std::string &line)
+typedef std::pair<bool, Cubeoid> RebootStep;
+
+RebootStep parse_line(const std::string &line)
 {
     static const std::regex regx("(\\w+) x=(-?\\d+)..(-?\\d+),y=(-?\\d+)..(-?\\d+),z=(-?\\d+)..(-?\\d+)");
     const auto [status, x1, x2, y1, y2, z1, z2] = aoc::search<7>(line, regx);
@@ -212,26 +364,275 @@ std::pair<bool, Cubeoid> parse_line(const std::string &line)
     return {status == "on", cubeoid};
 }
 
-uint64_t solve(const std::vector<std::string> &input, bool part2 = false)
+std::vector<RebootStep> parse(const std::vector<std::string> &input)
 {
-    const Cubeoid p1_region = {-50, 50, -50, 50, -50, 50};
+    std::vector<RebootStep> res;
+    res.reserve(input.size());
+    ranges::transform(input, std::back_inserter(res), parse_line);
+    return res;
+}
 
-    Space space;
-    for (const auto &line : input)
+enum class Strategy
+{
+    fragments,
+    signed_volumes,
+    compression
+};
+
+// Cells about as large as a typical step keep both the cells per fragment
+// and the fragments per cell small, but no step may span more than a few
+// hundred cells, or a mix of tiny and huge steps would flood the grid.
+Space build_space(const std::vector<RebootStep> &steps)
+{
+    std::vector<int64_t> sizes;
+    for (const auto &[on, c] : steps)
     {
-        const auto c = parse_line(line);
-        if (!part2 && !c.second.is_inside_cubeoid(p1_region))
+        sizes.push_back(std::max({c.x_max - c.x_min, c.y_max - c.y_min, c.z_max - c.z_min}) + 1);
+    }
+    if (sizes.empty())
+    {
+        return Space();
+    }
+    const auto largest = ranges::max(sizes);
+    ranges::nth_element(sizes, sizes.begin() + sizes.size() / 2);
+    Space space(std::max(sizes[sizes.size() / 2], largest / 8));
+    ranges::for_each(steps, [&space](const auto &step)
+                     { space.insert(step); });
+    return space;
+}
+
+uint64_t reboot_fragments(const std::vector<RebootStep> &steps)
+{
+    return build_space(steps).count();
+}
+
+// Inclusion-exclusion: every step cancels its intersection with each signed
+// cuboid so far, and an "on" step then adds itself. Equal cuboids share one
+// entry, so repeated intersections cancel out instead of piling up. Entries
+// live in a flat vector for the scan, with a hash from cuboid to entry for
+// the merging; cancelled entries are compacted away once they add up.
+uint64_t reboot_signed_volumes(const std::vector<RebootStep> &steps)
+{
+    std::vector<std::pair<Cubeoid, int64_t>> volumes;
+    std::unordered_map<Cubeoid, uint64_t, cubeoid_hash> entries;
+    std::unordered_map<Cubeoid, int64_t, cubeoid_hash> updates;
+    uint64_t cancelled = 0;
+    for (const auto &[on, cubeoid] : steps)
+    {
+        updates.clear();
+        for (const auto &[c, sign] : volumes)
+        {
+            if (sign != 0 && c.intersects(cubeoid))
+            {
+                updates[c.intersection(cubeoid)] -= sign;
+            }
+        }
+        if (on)
+        {
+            updates[cubeoid] += 1;
+        }
+        for (const auto &[c, sign] : updates)
+        {
+            if (sign == 0)
+            {
+                continue;
+            }
+            const auto [entry, added] = entries.try_emplace(c, volumes.size());
+            if (added)
+            {
+                volumes.push_back({c, 0});
+            }
+            auto &volume = volumes[entry->second].second;
+            cancelled += volume != 0 && volume + sign == 0;
+            cancelled -= volume == 0 && !added;
+            volume += sign;
+        }
+        if (cancelled * 2 > volumes.size())
+        {
+            std::erase_if(volumes, [](const auto &volume)
+                          { return volume.second == 0; });
+            entries.clear();
+            for (uint64_t i = 0; i < volumes.size(); i++)
+            {
+                entries[volumes[i].first] = i;
+            }
+            cancelled = 0;
+        }
+    }
+    return std::accumulate(volumes.begin(), volumes.end(), 0l, [](auto acc, const auto &volume)
+                           { return acc + volume.second * static_cast<int64_t>(volume.first.count()); });
+}
+
+// Coordinate compression as a sweep along each axis in turn. The steps in
+// ops are in step order and all cover the current slab of the earlier axes;
+// the ones covering each slab of this axis are kept up to date from sorted
+// start and end events. On the last axis a cell is decided by the latest
+// step covering it.
+uint64_t swept_volume(const std::vector<RebootStep> &steps, const std::vector<uint32_t> &ops, uint64_t axis)
+{
+    std::vector<std::pair<int64_t, int64_t>> events;
+    events.reserve(ops.size() * 2);
+    for (const int64_t op : ops)
+    {
+        const auto [lo, hi] = steps[op].second.extent(axis);
+        events.push_back({lo, op});
+        events.push_back({hi, ~op});
+    }
+    ranges::sort(events);
+
+    uint64_t res = 0;
+    uint64_t active_on = 0;
+    std::vector<uint32_t> active;
+    for (uint64_t e = 0; e < events.size();)
+    {
+        const int64_t from = events[e].first;
+        for (; e < events.size() && events[e].first == from; e++)
+        {
+            const auto op = events[e].second;
+            if (op >= 0)
+            {
+                active.insert(ranges::upper_bound(active, op), op);
+                active_on += steps[op].first;
+            }
+            else
+            {
+                active.erase(ranges::lower_bound(active, ~op));
+                active_on -= steps[~op].first;
+            }
+        }
+        if (e == events.size() || active_on == 0)
         {
             continue;
         }
-        space.insert(c);
+        const uint64_t length = events[e].first - from;
+        if (axis == 2)
+        {
+            res += steps[active.back()].first ? length : 0;
+        }
+        else
+        {
+            res += length * swept_volume(steps, active, axis + 1);
+        }
+    }
+    return res;
+}
+
+// Sweeping all steps at once revisits every step spanning a slab once per
+// slab, so larger sets are first cut in half at the median start along their
+// longest axis, with each step clipped to the half it falls into, until a
+// sweep is cheap. Steps before the first "on" of a part cannot matter.
+uint64_t reboot_compression(std::vector<RebootStep> steps)
+{
+    constexpr uint64_t leaf_size = 32;
+
+    const auto first_on = ranges::find_if(steps, [](const auto &step)
+                                          { return step.first; });
+    steps.erase(steps.begin(), first_on);
+    if (steps.size() > leaf_size)
+    {
+        Cubeoid bounds = steps[0].second;
+        for (const auto &[on, c] : steps)
+        {
+            bounds = {std::min(bounds.x_min, c.x_min), std::max(bounds.x_max, c.x_max),
+                      std::min(bounds.y_min, c.y_min), std::max(bounds.y_max, c.y_max),
+                      std::min(bounds.z_min, c.z_min), std::max(bounds.z_max, c.z_max)};
+        }
+        std::array<uint64_t, 3> axes = {0, 1, 2};
+        ranges::sort(axes, [&bounds](const auto a, const auto b)
+                     { return bounds.extent(a).second - bounds.extent(a).first >
+                              bounds.extent(b).second - bounds.extent(b).first; });
+        for (const auto axis : axes)
+        {
+            std::vector<int64_t> starts;
+            for (const auto &step : steps)
+            {
+                starts.push_back(step.second.extent(axis).first);
+            }
+            ranges::nth_element(starts, starts.begin() + starts.size() / 2);
+            const int64_t split = starts[starts.size() / 2];
+            const auto [lo, hi] = bounds.extent(axis);
+            if (split <= lo || split >= hi)
+            {
+                continue;
+            }
+
+            const std::array<Cubeoid, 2> halves = {bounds.with_extent(axis, lo, split),
+                                                   bounds.with_extent(axis, split, hi)};
+            std::array<std::vector<RebootStep>, 2> parts;
+            for (const auto &[on, c] : steps)
+            {
+                for (uint64_t h = 0; h < 2; h++)
+                {
+                    if (c.intersects(halves[h]))
+                    {
+                        parts[h].push_back({on, c.intersection(halves[h])});
+                    }
+                }
+            }
+            // Mostly steps spanning the whole part, which cutting cannot help.
+            if (std::max(parts[0].size(), parts[1].size()) * 10 > steps.size() * 9)
+            {
+                break;
+            }
+            return reboot_compression(std::move(parts[0])) + reboot_compression(std::move(parts[1]));
+        }
+    }
+
+    std::vector<uint32_t> ops(steps.size());
+    std::iota(ops.begin(), ops.end(), 0u);
+    return swept_volume(steps, ops, 0);
+}
+
+uint64_t reboot(const std::vector<RebootStep> &steps, Strategy strategy = Strategy::fragments)
+{
+    switch (strategy)
+    {
+    case Strategy::signed_volumes:
+        return reboot_signed_volumes(steps);
+    case Strategy::compression:
+        return reboot_compression(steps);
+    default:
+        return reboot_fragments(steps);
     }
-    return space.count();
+}
+
+const Cubeoid p1_region = {-50, 50, -50, 50, -50, 50};
+
+uint64_t solve(const std::vector<std::string> &input, bool part2 = false, Strategy strategy = Strategy::fragments)
+{
+    std::vector<RebootStep> steps;
+    ranges::copy_if(parse(input), std::back_inserter(steps), [part2](const auto &step)
+                    { return part2 || step.second.is_inside_cubeoid(p1_region); });
+    return reboot(steps, strategy);
+}
+
+std::vector<RebootStep> generate(uint64_t count, int64_t space, int64_t size, uint64_t seed)
+{
+    const auto next = [&seed](int64_t range)
+    {
+        seed = seed * 6364136223846793005ul + 1442695040888963407ul;
+        return static_cast<int64_t>((seed >> 33) % range);
+    };
+    std::vector<RebootStep> res;
+    for (uint64_t i = 0; i < count; i++)
+    {
+        Cubeoid c;
+        c.x_min = next(space) - space / 2;
+        c.x_max = c.x_min + next(size);
+        c.y_min = next(space) - space / 2;
+        c.y_max = c.y_min + next(size);
+        c.z_min = next(space) - space / 2;
+        c.z_max = c.z_min + next(size);
+        res.push_back({next(4) != 0, c});
+    }
+    return res;
 }
 
 int main()
 {
     const aoc::StopWatch stop_watch;
+    const std::array strategies = {Strategy::fragments, Strategy::signed_volumes, Strategy::compression};
+    const std::array names = {"fragments", "signed volumes", "compression"};
 
     {
         std::vector<std::string> test_input = {
@@ -239,7 +640,10 @@ int main()
             "on x=11..13,y=11..13,z=11..13",
             "off x=9..11,y=9..11,z=9..11",
             "on x=10..10,y=10..10,z=10..10"};
-        aoc::assert_equal(solve(test_input), 39ul);
+        for (const auto strategy : strategies)
+        {
+            aoc::assert_equal(solve(test_input, false, strategy), 39ul);
+        }
     }
     {
         std::vector<std::string> test_input = {
@@ -257,15 +661,98 @@ int main()
             "on x=0..8,y=0..3,z=0..3",
             "off x=-10..20,y=1..2,z=1..2",
         };
-        aoc::assert_equal(solve(test_input), 126ul);
+        for (const auto strategy : strategies)
+        {
+            aoc::assert_equal(solve(test_input, false, strategy), 126ul);
+        }
     }
     {
         const auto lines = aoc::get_lines("test.txt");
-        aoc::assert_equal(solve(lines), 590784ul);
+        for (const auto strategy : strategies)
+        {
+            aoc::assert_equal(solve(lines, false, strategy), 590784ul);
+        }
+        aoc::assert_equal(build_space(parse(lines)).count(p1_region), 590784ul);
+    }
+    {
+        const auto space = build_space(parse({"on x=0..9,y=0..9,z=0..9", "on x=5..14,y=5..14,z=5..14"}));
+        const Cubeoid wide = {-100000000, 100000000, 0, 14, 0, 14};
+        aoc::assert_equal(space.count(wide), 1875ul);
     }
 
     const auto lines = aoc::get_lines("input.txt");
     aoc::assert_equal(solve(lines), 567496ul);
     aoc::assert_equal(solve(lines, true), 1355961721298916ul);
+    {
+        const auto space = build_space(parse(lines));
+        aoc::assert_equal(space.count(p1_region), 567496ul);
+        aoc::assert_equal(space.count(), 1355961721298916ul);
+        const Cubeoid everything = {-1000000, 1000000, -1000000, 1000000, -1000000, 1000000};
+        aoc::assert_equal(space.count(everything), 1355961721298916ul);
+        const Cubeoid far_out = {-100000000, 100000000, 200000000, 300000000, -5, 5};
+        aoc::assert_equal(space.count(far_out), 0ul);
+        const int64_t huge = 1000000000000;
+        const Cubeoid oversized = {-huge, huge, -huge, huge, -huge, huge};
+        aoc::assert_equal(space.count(oversized), 1355961721298916ul);
+        aoc::assert_equal(Space().count(p1_region), 0ul);
+    }
+    for (const auto strategy : strategies)
+    {
+        aoc::assert_equal(solve(lines, true, strategy), 1355961721298916ul);
+    }
+
+    {
+        const auto steps = generate(2000, 200000, 20000, 22);
+        std::vector<uint64_t> results;
+        for (const auto strategy : strategies)
+        {
+            const aoc::StopWatch watch;
+            results.push_back(reboot(steps, strategy));
+            aoc::print("2000 steps, ", names[static_cast<int>(strategy)], ": ", results.back());
+        }
+        aoc::assert_equal(ranges::count(results, results[0]), 3l);
+    }
+    {
+        const auto steps = generate(20000, 1000000, 50000, 23);
+        std::vector<uint64_t> results;
+        for (const auto strategy : strategies)
+        {
+            const aoc::StopWatch watch;
+            results.push_back(reboot(steps, strategy));
+            aoc::print("20000 steps, ", names[static_cast<int>(strategy)], ": ", results.back());
+        }
+        aoc::assert_equal(ranges::count(results, results[0]), 3l);
+
+        const auto space = build_space(steps);
+        const auto windows = generate(10000, 1000000, 200000, 24);
+        for (const auto &[on, window] : windows | ranges::views::take(20))
+        {
+            std::vector<RebootStep> clipped;
+            for (const auto &[step_on, c] : steps)
+            {
+                if (c.intersects(window))
+                {
+                    clipped.push_back({step_on, c.intersection(window)});
+                }
+            }
+            aoc::assert_equal(space.count(window), reboot_compression(clipped));
+        }
+        const aoc::StopWatch watch;
+        uint64_t total = 0;
+        for (const auto &[on, window] : windows)
+        {
+            total += space.count(window);
+        }
+        aoc::print("10000 window queries: ", total);
+    }
+    {
+        auto steps = generate(2000, 1000, 3, 25);
+        const auto huge = generate(4, 1000000, 2000000, 26);
+        steps.insert(steps.begin() + 1000, huge.begin(), huge.end());
+        const aoc::StopWatch watch;
+        const auto fragments = reboot(steps, Strategy::fragments);
+        aoc::assert_equal(fragments, reboot(steps, Strategy::compression));
+        aoc::print("tiny and huge steps mixed: ", fragments);
+    }
     return 0;
 }
@@ -1,227 +1,626 @@
+#include <atomic>
+#include <bit>
+#include <deque>
+#include <mutex>
+#include <numeric>
+#include <queue>
+#include <thread>
 #include "aoc_library.hpp"
 
 
 namespace ranges = std::ranges;
 
-struct Amiphod
-{
-    char type;
-    uint64_t at_pos;
-    
-    auto operator<=>(const Amiphod &) const = default;
-};
+typedef unsigned __int128 StateKey;
 
-struct State
+// Open addressing over packed state keys, holding the lowest cost found so
+// far. The all-empty key cannot be a state and marks free slots.
+class CostTable
 {
-    State(const std::vector<Amiphod>& amis)
+public:
+    CostTable(uint64_t capacity = 1 << 16)
+        : keys_(capacity, 0),
+          costs_(capacity)
+    {
+    }
+
+    uint32_t &operator[](StateKey key)
     {
-        blocked_pos = std::vector<bool>(27, false);
-        for (const auto& ami : amis)
+        if ((size_ + 1) * 2 > keys_.size())
+        {
+            grow();
+        }
+        const auto slot = find(key);
+        if (keys_[slot] == 0)
         {
-            unfinished_ami.push_back(ami);
-            blocked_pos.at(ami.at_pos) = true;
+            keys_[slot] = key;
+            costs_[slot] = std::numeric_limits<uint32_t>::max();
+            size_++;
         }
+        return costs_[slot];
     }
 
-    std::vector<bool> blocked_pos;
-    uint64_t total_cost = 0;
-    std::vector<Amiphod> unfinished_ami;
-};
-
-struct Rules
-{
-    std::vector<std::vector<uint64_t>> graph = {
-        {1},
-        {0, 2},
-        {1, 3, 11},
-        {2, 4},
-        {3, 5, 15},
-        {4, 6},
-        {5, 7, 19},
-        {6, 8},
-        {7, 9, 23},
-        {8, 10},
-        {9},
-        {2, 12},
-        {11, 13},
-        {12, 14},
-        {13},
-        {4, 16},
-        {15, 17},
-        {16, 18},
-        {17},
-        {6, 20},
-        {19, 21},
-        {20, 22},
-        {21},
-        {8, 24},
-        {23, 25},
-        {24, 26},
-        {25},
-    };
-
-    std::unordered_map<char, uint64_t> step_cost = {
-        {'A', 1ul},
-        {'B', 10ul},
-        {'C', 100ul},
-        {'D', 1000ul},
-    };
-
-    std::vector<std::vector<uint64_t>> groups = {
-        {11, 12, 13, 14},
-        {15, 16, 17, 18},
-        {19, 20, 21, 22},
-        {23, 24, 25, 26},
-    };
-
-    std::unordered_map<char, std::vector<uint64_t>> home = {
-        {'A', groups.at(0)},
-        {'B', groups.at(1)},
-        {'C', groups.at(2)},
-        {'D', groups.at(3)},
-    };
+    uint64_t size() const
+    {
+        return size_;
+    }
 
-    std::vector<uint64_t> belonging_group(uint64_t place) const
+private:
+    uint64_t find(StateKey key) const
     {
-        if (place < 11)
+        const uint64_t mask = keys_.size() - 1;
+        uint64_t slot = ((static_cast<uint64_t>(key) ^ static_cast<uint64_t>(key >> 64) * 0x9e3779b97f4a7c15ul) *
+                         0xff51afd7ed558ccdul) >> 20;
+        for (slot &= mask; keys_[slot] != 0 && keys_[slot] != key; slot = (slot + 1) & mask)
         {
-            return {};
         }
-        return groups.at((place - 11) / 4);
+        return slot;
     }
 
-    bool is_hallway(uint64_t pos) const
+    void grow()
     {
-        return pos < 11;
+        auto keys = std::move(keys_);
+        auto costs = std::move(costs_);
+        keys_.assign(keys.size() * 2, 0);
+        costs_.resize(keys_.size());
+        for (uint64_t i = 0; i < keys.size(); i++)
+        {
+            if (keys[i] != 0)
+            {
+                const auto slot = find(keys[i]);
+                keys_[slot] = keys[i];
+                costs_[slot] = costs[i];
+            }
+        }
     }
 
-    bool ok_to_stop(uint64_t pos) const
+    uint64_t size_ = 0;
+    std::vector<StateKey> keys_;
+    std::vector<uint32_t> costs_;
+};
+
+// A burrow parsed from the puzzle's diagram: a hallway of any length with
+// any number of rooms of equal depth below it, room i being home to the
+// i-th letter. A state is the hallway stops, the spaces not right above a
+// room, followed by the rooms top to bottom, with just enough bits per
+// cell for 0 as empty and 1 up to the room count as A, B, ... so it packs
+// into a 128-bit key. The stops in the way between any stop and room door,
+// and between any two doors, are precomputed as masks over the stops.
+class Burrow
+{
+public:
+    static constexpr uint64_t max_cells = 64;
+
+    typedef std::array<uint8_t, max_cells> Cells;
+
+    Burrow(const std::vector<std::string> &diagram)
     {
-        return pos != 2 && pos != 4 && pos != 6 && pos != 8;
+        const auto &hallway = diagram[1];
+        for (uint64_t row = 2; row < diagram.size(); row++)
+        {
+            if (diagram[row].find_first_of(".ABCDEFGHIJKLMNOPQRSTUVWXYZ") == std::string::npos)
+            {
+                continue;
+            }
+            depth_++;
+            for (uint64_t column = 0; column < diagram[row].size(); column++)
+            {
+                if (row == 2 && diagram[row][column] != '#' && diagram[row][column] != ' ')
+                {
+                    doors_.push_back(column - 1);
+                }
+            }
+        }
+        for (int64_t x = 0; x + 2 < static_cast<int64_t>(hallway.size()); x++)
+        {
+            if (ranges::find(doors_, x) == doors_.end())
+            {
+                stops_.push_back(x);
+            }
+        }
+        bits_ = std::bit_width(doors_.size());
+        assert(stops_.size() <= 64 && cell_count() <= max_cells && cell_count() * bits_ <= 128);
+        step_cost_ = {0};
+        for (uint64_t type = 1, cost = 1; type <= doors_.size(); type++, cost *= 10)
+        {
+            step_cost_.push_back(cost);
+        }
+
+        const auto mask_between = [this](int64_t from, int64_t to)
+        {
+            const auto [lo, hi] = std::minmax(from, to);
+            uint64_t res = 0;
+            for (uint64_t s = 0; s < stops_.size(); s++)
+            {
+                res |= static_cast<uint64_t>(stops_[s] > lo && stops_[s] < hi) << s;
+            }
+            return res;
+        };
+        for (const auto stop : stops_)
+        {
+            for (const auto door : doors_)
+            {
+                stop_paths_.push_back(mask_between(stop, door));
+                stop_steps_.push_back(std::abs(stop - door));
+            }
+        }
+        for (const auto from : doors_)
+        {
+            for (const auto to : doors_)
+            {
+                room_paths_.push_back(mask_between(from, to));
+                // Leaving a room to come back in takes a step aside and back.
+                room_steps_.push_back(from == to ? 2 : std::abs(from - to));
+            }
+        }
+
+        Cells start = {};
+        Cells goal = {};
+        std::vector<uint64_t> counts(doors_.size() + 1, 0);
+        for (uint64_t s = 0; s < stops_.size(); s++)
+        {
+            start[s] = type_of(hallway[stops_[s] + 1]);
+            counts[start[s]]++;
+        }
+        for (uint64_t r = 0; r < doors_.size(); r++)
+        {
+            for (uint64_t i = 0; i < depth_; i++)
+            {
+                start[room(r, i)] = type_of(diagram[2 + i][doors_[r] + 1]);
+                counts[start[room(r, i)]]++;
+            }
+        }
+        for (uint64_t r = 0; r < doors_.size(); r++)
+        {
+            assert(counts[r + 1] <= depth_);
+            for (uint64_t i = depth_ - counts[r + 1]; i < depth_; i++)
+            {
+                goal[room(r, i)] = r + 1;
+            }
+        }
+        start_ = encode(start);
+        goal_ = encode(goal);
     }
 
-    std::optional<uint64_t>
-    found_home(const Amiphod& ami, const std::vector<uint64_t> room, const State& state) const
+    // A* over packed states, with the cost of moving every amphipod home as
+    // if nothing were in the way as the heuristic.
+    uint64_t solve() const
     {
-        const auto free_room_spots = ranges::count_if(room, [&state](const auto place)
-                                                            { return !state.blocked_pos[place]; });
-        const auto unfinished_my_type = ranges::count_if(state.unfinished_ami, [&ami](const auto & ami2)
-                                                                { return ami2.type == ami.type; });
-        if (free_room_spots == unfinished_my_type)
+        typedef std::tuple<uint32_t, uint32_t, StateKey> Entry;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<>> queue;
+        CostTable best;
+        best[start_] = 0;
+        queue.push({heuristic(decode(start_)), 0, start_});
+        while (!queue.empty())
         {
-            return free_room_spots;
+            const auto [estimate, cost, key] = queue.top();
+            queue.pop();
+            if (key == goal_)
+            {
+                return cost;
+            }
+            if (cost > best[key])
+            {
+                continue;
+            }
+            const auto cells = decode(key);
+            moves(cells, [&](const Cells &next, uint32_t move_cost)
+                  {
+                      const auto next_key = encode(next);
+                      auto &known = best[next_key];
+                      if (cost + move_cost < known)
+                      {
+                          known = cost + move_cost;
+                          queue.push({known + heuristic(next), known, next_key});
+                      }
+                  });
         }
-        return std::nullopt;
+        return std::numeric_limits<uint64_t>::max();
     }
 
-    std::vector<std::pair<uint64_t, uint64_t>>
-    search_move(const Amiphod& ami, const State& state)
+    // Branch and bound from several threads. The first few levels of moves
+    // become tasks on per-thread deques, taken from the back by their owner
+    // and stolen from the front by idle threads; deeper levels are searched
+    // depth first in place. All threads prune against one atomic best cost
+    // and share a transposition table of the cheapest cost each state has
+    // been reached with, split into independently locked shards. The number
+    // of states expanded goes to expanded if given.
+    uint64_t solve(unsigned threads, uint64_t *expanded = nullptr) const
     {
-        const bool start_in_hallway = is_hallway(ami.at_pos);
-        const auto& exiting_group = belonging_group(ami.at_pos);
-        std::vector<std::pair<uint64_t, uint64_t>> to_visit = {{ami.at_pos, 0}};
-        std::vector<std::pair<uint64_t, uint64_t>> ok_pos = {};
-        std::vector<uint64_t> checked;
+        constexpr uint64_t task_levels = 3;
+        constexpr uint64_t shard_count = 64;
+        struct Task
+        {
+            StateKey key;
+            uint32_t cost;
+            uint32_t level;
+        };
+        struct Shard
+        {
+            std::mutex lock;
+            CostTable costs{1 << 12};
+        };
+
+        threads = std::max(threads, 1u);
+        std::vector<std::deque<Task>> queues(threads);
+        std::vector<std::mutex> queue_locks(threads);
+        std::vector<Shard> shards(shard_count);
+        std::atomic<uint32_t> best = std::numeric_limits<uint32_t>::max();
+        std::atomic<uint64_t> pending = 1;
+        std::vector<uint64_t> expansions(threads, 0);
+        queues[0].push_back({start_, 0, 0});
 
-        while(!to_visit.empty())
+        const auto improve = [&best](uint32_t cost)
         {
-            const auto [check, steps] = to_visit.back();
-            to_visit.pop_back();
-            checked.push_back(check);
+            for (auto known = best.load(); cost < known && !best.compare_exchange_weak(known, cost);)
+            {
+            }
+        };
 
-            const auto possible_next = graph[check];
-            for (const auto & next : possible_next)
+        const auto search = [&](auto &self, const Task &task, unsigned worker) -> void
+        {
+            if (task.key == goal_)
             {
-                if (state.blocked_pos[next])
+                improve(task.cost);
+                return;
+            }
+            const auto cells = decode(task.key);
+            if (task.cost + heuristic(cells) >= best.load(std::memory_order_relaxed))
+            {
+                return;
+            }
+            {
+                auto &shard = shards[static_cast<uint64_t>(task.key ^ (task.key >> 64)) % shard_count];
+                const std::lock_guard guard(shard.lock);
+                auto &known = shard.costs[task.key];
+                if (known <= task.cost)
                 {
-                    continue;
+                    return;
+                }
+                known = task.cost;
+            }
+            expansions[worker]++;
+
+            // Cheapest estimate first, so a good bound turns up early.
+            std::vector<std::pair<uint32_t, Task>> children;
+            moves(cells, [&](const Cells &next, uint32_t move_cost)
+                  {
+                      const uint32_t cost = task.cost + move_cost;
+                      children.push_back({cost + heuristic(next), {encode(next), cost, task.level + 1}});
+                  });
+            ranges::sort(children, {}, &std::pair<uint32_t, Task>::first);
+            if (task.level < task_levels)
+            {
+                const std::lock_guard guard(queue_locks[worker]);
+                // The owner pops from the back, so push the best child last.
+                for (const auto &child : children | ranges::views::reverse)
+                {
+                    pending++;
+                    queues[worker].push_back(child.second);
                 }
-                if (ranges::find(checked, next) != checked.end())
+                return;
+            }
+            for (const auto &[estimate, child] : children)
+            {
+                if (estimate < best.load(std::memory_order_relaxed))
                 {
-                    continue;
+                    self(self, child, worker);
                 }
-                if (!is_hallway(next) && // is room and not on initial exit
-                    ranges::find(exiting_group, next) == exiting_group.end())
+            }
+        };
+
+        const auto take = [&](unsigned worker) -> std::optional<Task>
+        {
+            for (unsigned i = 0; i < threads; i++)
+            {
+                const unsigned victim = (worker + i) % threads;
+                const std::lock_guard guard(queue_locks[victim]);
+                auto &queue = queues[victim];
+                if (queue.empty())
                 {
-                    const auto my_room = home.at(ami.type);
-                    if (ranges::find(my_room, next) == my_room.end())
-                    {
-                        continue;
-                    }
-                    const auto found = found_home(ami, my_room, state);
-                    if (!found)
-                    {
-                        continue;
-                    }
-                    return {{my_room[found.value() - 1], steps + found.value()}};
+                    continue;
                 }
+                const auto task = victim == worker ? queue.back() : queue.front();
+                victim == worker ? queue.pop_back() : queue.pop_front();
+                return task;
+            }
+            return std::nullopt;
+        };
 
-                to_visit.push_back({next, steps + 1});
-                if (ok_to_stop(next) && 
-                    !(start_in_hallway && is_hallway(next)) &&
-                    is_hallway(next))
+        const auto work = [&](unsigned worker)
+        {
+            while (pending.load() > 0)
+            {
+                if (const auto task = take(worker))
+                {
+                    search(search, *task, worker);
+                    pending--;
+                }
+                else
                 {
-                    ok_pos.push_back({next, steps + 1});
+                    std::this_thread::yield();
                 }
             }
+        };
+
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; t++)
+        {
+            workers.emplace_back(work, t);
         }
-        return ok_pos;
+        work(0);
+        ranges::for_each(workers, [](auto &worker)
+                         { worker.join(); });
+
+        if (expanded)
+        {
+            *expanded = std::accumulate(expansions.begin(), expansions.end(), 0ul);
+        }
+        const auto res = best.load();
+        return res == std::numeric_limits<uint32_t>::max() ? std::numeric_limits<uint64_t>::max() : res;
     }
 
-    void best_solution(const State& state, uint64_t& best_cost)
+    uint64_t depth() const { return depth_; }
+    uint64_t room_count() const { return doors_.size(); }
+    uint64_t stop_count() const { return stops_.size(); }
+
+private:
+    static uint8_t type_of(char c)
     {
-        if (state.unfinished_ami.empty())
+        return c >= 'A' && c <= 'Z' ? c - 'A' + 1 : 0;
+    }
+
+    uint64_t room(uint64_t r, uint64_t i) const
+    {
+        return stops_.size() + r * depth_ + i;
+    }
+
+    uint64_t cell_count() const
+    {
+        return stops_.size() + doors_.size() * depth_;
+    }
+
+    StateKey encode(const Cells &cells) const
+    {
+        StateKey res = 0;
+        for (uint64_t i = 0; i < cell_count(); i++)
         {
-            best_cost = state.total_cost;
+            res |= static_cast<StateKey>(cells[i]) << (bits_ * i);
         }
-        // for each unfinished amiphod and for each res from search_move()
-            // recurse on updated state if cost is less than prev found lowest cost
-        for (const auto& ami : state.unfinished_ami)
+        return res;
+    }
+
+    Cells decode(StateKey key) const
+    {
+        const uint8_t mask = (1 << bits_) - 1;
+        Cells res = {};
+        for (uint64_t i = 0; i < cell_count(); i++)
         {
-            for (const auto& move : search_move(ami, state))
+            res[i] = static_cast<uint8_t>(key >> (bits_ * i)) & mask;
+        }
+        return res;
+    }
+
+    // Amphipods from the bottom up that are home with only their own kind
+    // below them.
+    uint64_t settled(const Cells &cells, uint64_t r) const
+    {
+        uint64_t res = 0;
+        while (res < depth_ && cells[room(r, depth_ - 1 - res)] == r + 1)
+        {
+            res++;
+        }
+        return res;
+    }
+
+    uint32_t heuristic(const Cells &cells) const
+    {
+        const uint64_t rooms = doors_.size();
+        uint32_t res = 0;
+        std::array<uint32_t, max_cells> entering = {};
+        for (uint64_t s = 0; s < stops_.size(); s++)
+        {
+            if (const auto type = cells[s])
+            {
+                res += step_cost_[type] * stop_steps_[s * rooms + type - 1];
+                entering[type]++;
+            }
+        }
+        for (uint64_t r = 0; r < rooms; r++)
+        {
+            for (uint64_t i = 0; i + settled(cells, r) < depth_; i++)
             {
-                auto state_copy = state;
-                state_copy.total_cost += step_cost.at(ami.type) * move.second;
-                if (state_copy.total_cost >= best_cost)
+                if (const auto type = cells[room(r, i)])
                 {
-                    continue;
+                    res += step_cost_[type] * (i + 1 + room_steps_[r * rooms + type - 1]);
+                    entering[type]++;
                 }
-                auto me = ranges::find(state_copy.unfinished_ami, ami);
-                state_copy.blocked_pos.at(me->at_pos) = false;
-                me->at_pos = move.first;
-                state_copy.blocked_pos.at(me->at_pos) = true;
+            }
+        }
+        for (uint64_t type = 1; type <= rooms; type++)
+        {
+            res += step_cost_[type] * entering[type] * (entering[type] + 1) / 2;
+        }
+        return res;
+    }
+
+    // Amphipods either go from a stop straight to the deepest free place in
+    // their room once only their own kind is in it, or from the top of an
+    // unsettled room to a stop or straight into their open room. Whether the
+    // way is clear is one test of the occupied stops against a path mask.
+    template <typename F>
+    void moves(const Cells &cells, F f) const
+    {
+        const uint64_t rooms = doors_.size();
+        uint64_t occupied = 0;
+        for (uint64_t s = 0; s < stops_.size(); s++)
+        {
+            occupied |= static_cast<uint64_t>(cells[s] != 0) << s;
+        }
+        std::array<uint64_t, max_cells> free = {};
+        std::array<bool, max_cells> open = {};
+        for (uint64_t r = 0; r < rooms; r++)
+        {
+            for (; free[r] < depth_ && !cells[room(r, free[r])]; free[r]++)
+            {
+            }
+            open[r] = free[r] + settled(cells, r) == depth_;
+        }
+
+        for (uint64_t taken = occupied; taken; taken &= taken - 1)
+        {
+            const uint64_t s = std::countr_zero(taken);
+            const uint64_t home = cells[s] - 1;
+            if (!open[home] || (occupied & stop_paths_[s * rooms + home]))
+            {
+                continue;
+            }
+            auto next = cells;
+            next[s] = 0;
+            next[room(home, free[home] - 1)] = home + 1;
+            f(next, step_cost_[home + 1] * (stop_steps_[s * rooms + home] + free[home]));
+        }
 
-                const auto my_home = home.at(ami.type);
-                if (ranges::find(my_home, move.first) != my_home.end())
+        const uint64_t all_stops = stops_.size() == 64 ? ~0ul : (1ul << stops_.size()) - 1;
+        for (uint64_t r = 0; r < rooms; r++)
+        {
+            if (open[r] || free[r] == depth_)
+            {
+                continue;
+            }
+            const auto from = room(r, free[r]);
+            const auto type = cells[from];
+            const uint64_t home = type - 1;
+            if (home != r && open[home] && !(occupied & room_paths_[r * rooms + home]))
+            {
+                auto next = cells;
+                next[from] = 0;
+                next[room(home, free[home] - 1)] = type;
+                f(next, step_cost_[type] * (free[r] + 1 + room_steps_[r * rooms + home] + free[home]));
+            }
+            for (uint64_t empty = all_stops & ~occupied; empty; empty &= empty - 1)
+            {
+                const uint64_t s = std::countr_zero(empty);
+                if (occupied & stop_paths_[s * rooms + r])
                 {
-                    state_copy.unfinished_ami.erase(me);
+                    continue;
                 }
-                best_solution(state_copy, best_cost);
+                auto next = cells;
+                next[from] = 0;
+                next[s] = type;
+                f(next, step_cost_[type] * (free[r] + 1 + stop_steps_[s * rooms + r]));
             }
         }
-        return;
     }
+
+    uint64_t depth_ = 0;
+    uint64_t bits_;
+    std::vector<int64_t> doors_;
+    std::vector<int64_t> stops_;
+    std::vector<uint32_t> step_cost_;
+    std::vector<uint64_t> stop_paths_;
+    std::vector<uint32_t> stop_steps_;
+    std::vector<uint64_t> room_paths_;
+    std::vector<uint32_t> room_steps_;
+    StateKey start_;
+    StateKey goal_;
 };
 
+// Part 2 folds out two more rows below the first row of rooms.
+std::vector<std::string> unfold(std::vector<std::string> diagram)
+{
+    diagram.insert(diagram.begin() + 3, {"  #D#C#B#A#", "  #D#B#A#C#"});
+    return diagram;
+}
+
+// Rooms with one amphipod of each kind per row, in random order, below a
+// hallway with gap stops between neighbouring rooms and two at each end.
+std::vector<std::string> generate(uint64_t rooms, uint64_t depth, uint64_t gap, uint64_t seed)
+{
+    const uint64_t width = (gap + 1) * (rooms - 1) + 5;
+    std::vector<std::string> res = {std::string(width + 2, '#'), std::string(width + 2, '.')};
+    res[1].front() = res[1].back() = '#';
+    for (uint64_t i = 0; i < depth; i++)
+    {
+        std::string row;
+        for (uint64_t r = 0; r < rooms; r++)
+        {
+            row.push_back('A' + r);
+        }
+        for (uint64_t j = rooms - 1; j > 0; j--)
+        {
+            seed = seed * 6364136223846793005ul + 1442695040888963407ul;
+            std::swap(row[j], row[(seed >> 33) % (j + 1)]);
+        }
+        std::string line(width + 2, i == 0 ? '#' : ' ');
+        for (uint64_t r = 0; r < rooms; r++)
+        {
+            const uint64_t column = (gap + 1) * r + 3;
+            line[column] = row[r];
+            line[column - 1] = line[column + 1] = '#';
+        }
+        res.push_back(line);
+    }
+    return res;
+}
+
 int main()
 {
     const aoc::StopWatch stop_watch;
+    aoc::assert_equal(Burrow({"#############",
+                              "#...........#",
+                              "###.#A#.#.###",
+                              "  #.#A#.#.#",
+                              "  #.#A#.#.#",
+                              "  #.#A#.#.#",
+                              "  #########"})
+                          .solve(),
+                      28ul);
+    {
+        const auto lines = aoc::get_lines("test.txt");
+        aoc::assert_equal(Burrow(lines).solve(), 12521ul);
+        aoc::assert_equal(Burrow(unfold(lines)).solve(), 44169ul);
+        aoc::assert_equal(Burrow(lines).solve(3), 12521ul);
+        aoc::assert_equal(Burrow(unfold(lines)).solve(3), 44169ul);
+    }
+
+    const auto lines = aoc::get_lines("input.txt");
+    aoc::assert_equal(Burrow(lines).solve(), 14348ul);         // part 1 solution
+    aoc::assert_equal(Burrow(unfold(lines)).solve(), 40954ul); // part 2 solution
+    aoc::assert_equal(Burrow(unfold(lines)).solve(4), 40954ul);
+
+    for (const auto &[rooms, depth, gap, seed] : {std::array{4ul, 4ul, 1ul, 0ul}, std::array{5ul, 3ul, 1ul, 2ul},
+                                                  std::array{6ul, 2ul, 1ul, 2ul}, std::array{4ul, 4ul, 2ul, 0ul},
+                                                  std::array{4ul, 5ul, 2ul, 1ul}})
     {
-        Rules rules;
-        State test_state({{'A', 18}, {'A', 17}, {'A', 16}, {'A', 15}});
-        uint64_t best_cost = std::numeric_limits<uint64_t>::max();
-        rules.best_solution(test_state, best_cost);
-        aoc::assert_equal(best_cost, 28ul);
-    }
-    
-    Rules rules;
-    State p2_state({{'D', 11}, {'D', 12}, {'D', 13}, {'B', 14},
-                    {'A', 15}, {'C', 16}, {'B', 17}, {'C', 18},
-                    {'D', 19}, {'B', 20}, {'A', 21}, {'B', 22},
-                    {'C', 23}, {'A', 24}, {'C', 25}, {'A', 26}});
-    uint64_t best_cost = std::numeric_limits<uint64_t>::max();
-    rules.best_solution(p2_state, best_cost);
-    aoc::assert_equal(best_cost, 40954ul); // part 2 solution
+        const Burrow burrow(generate(rooms, depth, gap, seed));
+        uint64_t cost = 0;
+        {
+            const aoc::StopWatch watch;
+            cost = burrow.solve();
+            aoc::print("generated ", rooms, " rooms, depth ", depth, ", ", burrow.stop_count(), " stops: ", cost);
+        }
+        {
+            const aoc::StopWatch watch;
+            const auto threads = std::max(2u, std::thread::hardware_concurrency());
+            aoc::assert_equal(burrow.solve(threads), cost);
+            aoc::print("  branch and bound, ", threads, " threads");
+        }
+    }
+    {
+        const Burrow burrow(generate(6, 3, 1, 2));
+        std::vector<uint64_t> costs;
+        for (const unsigned threads : {1u, std::max(2u, std::thread::hardware_concurrency())})
+        {
+            uint64_t states = 0;
+            const auto start = std::chrono::high_resolution_clock::now();
+            costs.push_back(burrow.solve(threads, &states));
+            const std::chrono::duration<double> seconds = std::chrono::high_resolution_clock::now() - start;
+            aoc::print("generated 6 rooms, depth 3, ", threads, " threads: ", costs.back(), ", ", states, " states, ",
+                       states / seconds.count() / 1e6, " Mstates/s");
+        }
+        aoc::assert_equal(costs[0], costs[1]);
+        aoc::assert_equal(costs[0], burrow.solve());
+    }
 
     return 0;
 }
@@ -1,6 +1,6 @@
+#include <stdexcept>
 #include <variant>
 #include <unordered_set>
-#include <functional>
 #include "aoc_library.hpp"
 
 namespace ranges = std::ranges;
@@ -22,70 +22,795 @@ inline int64_t z_func(int64_t prev_z, int64_t inp, const Var& v)
     return tmp * 26 + inp + v.var3;
 }
 
-typedef std::function<bool(int64_t, int64_t)> Comparator;
+// The ALU program as bytecode. Besides the six puzzle instructions there
+// are set and cpy, which constant folding produces from sequences such as
+// "mul x 0" followed by "add x z".
+enum class Op : uint8_t
+{
+    inp,
+    add,
+    mul,
+    div,
+    mod,
+    eql,
+    set,
+    cpy
+};
+
+struct Instruction
+{
+    Op op;
+    uint8_t a;
+    bool immediate;
+    int64_t b;
+};
+
+typedef std::array<int64_t, 4> Registers;
+
+// The puzzle leaves division and modulo by zero undefined; the interpreter,
+// the batched lanes and constant folding all make them yield 0.
+inline int64_t alu_div(int64_t a, int64_t b)
+{
+    return b ? a / b : 0;
+}
 
-int64_t solve(const std::vector<std::string>& lines, const Comparator& cmp)
+inline int64_t alu_mod(int64_t a, int64_t b)
 {
-    std::vector<Var> sections;
-    static const std::regex regx("\\w+ \\w\\s*([-\\d\\w]+)*");
+    return b ? a % b : 0;
+}
 
-    auto start = lines.begin();
-    while (true)
+// A node of a block's result as an expression over its z and digit w, with
+// constants folded as the nodes are made.
+struct Expression
+{
+    enum Kind : uint8_t
     {
-        const auto target = std::find_if(start + 1, lines.end(), [](const auto& line)
-                                            { return line.starts_with("inp"); });
-        Var section;
+        constant,
+        z,
+        w,
+        add,
+        mul,
+        div,
+        mod,
+        eql
+    };
+
+    Kind kind;
+    int64_t value;
+    uint32_t lhs;
+    uint32_t rhs;
+};
 
-        const auto [v1] = aoc::search<1>(*(start + 4), regx);
-        section.var1 = std::stoll(v1);
-        const auto [v2] = aoc::search<1>(*(start + 5), regx);
-        section.var2 = std::stoll(v2);
-        const auto [v3] = aoc::search<1>(*(start + 15), regx);
-        section.var3 = std::stoll(v3);
+// One stretch of the program from an inp up to the next. A block that does
+// not read x, y or w before writing them is a function of z and the digit
+// alone; if its result expression has the shape of z_func, that is used
+// instead.
+struct Block
+{
+    uint64_t first;
+    uint64_t last;
+    bool z_only;
+    std::optional<Var> step;
+};
 
-        sections.push_back(section);
-        if (target == lines.end())
-            break;
-        start = target;
+class Alu
+{
+public:
+    static constexpr uint64_t lanes = 8;
+
+    Alu(const std::vector<std::string> &lines)
+    {
+        static const std::unordered_map<std::string, Op> ops = {
+            {"inp", Op::inp}, {"add", Op::add}, {"mul", Op::mul}, {"div", Op::div}, {"mod", Op::mod}, {"eql", Op::eql}};
+        for (const auto &line : lines)
+        {
+            const auto parts = aoc::split(line, " ");
+            Instruction ins = {ops.at(parts[0]), static_cast<uint8_t>(parts[1][0] - 'w'), true, 0};
+            if (parts.size() > 2)
+            {
+                ins.immediate = !(parts[2][0] >= 'w' && parts[2][0] <= 'z');
+                ins.b = ins.immediate ? std::stoll(parts[2]) : parts[2][0] - 'w';
+            }
+            code_.push_back(ins);
+        }
+        fold();
+        split_blocks();
     }
 
-    std::unordered_map<int64_t, int64_t> prev_z = {{0, 0}};
-    std::unordered_map<int64_t, int64_t> tmp_prev_z = {};
+    uint64_t size() const { return code_.size(); }
+    uint64_t input_count() const { return blocks_.size(); }
+    const std::vector<Block> &blocks() const { return blocks_; }
 
-    for (const auto& v: sections)
+    // Registers after the instructions before the first inp, which are where
+    // every search over the blocks starts.
+    Registers run_prefix() const
     {
-        tmp_prev_z.clear();
-        for (const auto & [z, best] : prev_z)
+        Registers regs = {0, 0, 0, 0};
+        execute(0, blocks_.empty() ? code_.size() : blocks_.front().first, regs, nullptr);
+        return regs;
+    }
+
+    Registers run(const int64_t *input) const
+    {
+        Registers regs = {0, 0, 0, 0};
+        execute(0, code_.size(), regs, input);
+        return regs;
+    }
+
+    // Runs one block on its own, starting from the given z.
+    int64_t run_block(const Block &block, int64_t z, int64_t w) const
+    {
+        Registers regs = {0, 0, 0, z};
+        execute(block.first, block.last, regs, &w);
+        return regs[3];
+    }
+
+    // Final z for count inputs stored one after the other, lanes at a time,
+    // so each instruction is decoded once per batch and its loop over the
+    // lanes can be vectorized.
+    void run_batch(const int64_t *inputs, uint64_t count, int64_t *z) const
+    {
+        const uint64_t stride = input_count();
+        for (uint64_t first = 0; first < count; first += lanes)
         {
-            for (int64_t inp = 1; inp < 10; inp++)
+            const uint64_t n = std::min(lanes, count - first);
+            alignas(64) std::array<std::array<int64_t, lanes>, 4> regs = {};
+            uint64_t next_input = 0;
+            for (const auto &ins : code_)
             {
-                const auto nz = z_func(z, inp, v);
-                const int64_t val = best * 10 + inp;
-                if (tmp_prev_z.contains(nz))
+                auto &a = regs[ins.a];
+                std::array<int64_t, lanes> b;
+                if (ins.immediate)
+                {
+                    b.fill(ins.b);
+                }
+                else
                 {
-                    const auto prev_best = tmp_prev_z.at(nz);
-                    if (cmp(prev_best, val))
+                    b = regs[ins.b];
+                }
+                switch (ins.op)
+                {
+                case Op::inp:
+                    for (uint64_t l = 0; l < n; l++)
                     {
-                        tmp_prev_z.at(nz) = val;
+                        a[l] = inputs[(first + l) * stride + next_input];
                     }
+                    next_input++;
+                    break;
+                case Op::add:
+                    for (uint64_t l = 0; l < lanes; l++)
+                        a[l] += b[l];
+                    break;
+                case Op::mul:
+                    for (uint64_t l = 0; l < lanes; l++)
+                        a[l] *= b[l];
+                    break;
+                case Op::div:
+                    for (uint64_t l = 0; l < lanes; l++)
+                        a[l] = alu_div(a[l], b[l]);
+                    break;
+                case Op::mod:
+                    for (uint64_t l = 0; l < lanes; l++)
+                        a[l] = alu_mod(a[l], b[l]);
+                    break;
+                case Op::eql:
+                    for (uint64_t l = 0; l < lanes; l++)
+                        a[l] = a[l] == b[l];
+                    break;
+                case Op::set:
+                case Op::cpy:
+                    a = b;
+                    break;
                 }
-                else
+            }
+            std::copy_n(regs[3].begin(), n, z + first);
+        }
+    }
+
+private:
+    void execute(uint64_t first, uint64_t last, Registers &regs, const int64_t *input) const
+    {
+        for (uint64_t i = first; i < last; i++)
+        {
+            const auto &ins = code_[i];
+            auto &a = regs[ins.a];
+            const int64_t b = ins.immediate ? ins.b : regs[ins.b];
+            switch (ins.op)
+            {
+            case Op::inp:
+                a = *input++;
+                break;
+            case Op::add:
+                a += b;
+                break;
+            case Op::mul:
+                a *= b;
+                break;
+            case Op::div:
+                a = alu_div(a, b);
+                break;
+            case Op::mod:
+                a = alu_mod(a, b);
+                break;
+            case Op::eql:
+                a = a == b;
+                break;
+            case Op::set:
+            case Op::cpy:
+                a = b;
+                break;
+            }
+        }
+    }
+
+    // Tracks which registers hold known constants, dropping instructions
+    // that cannot change anything and turning those with a known result
+    // into set or cpy. Nothing is assumed at an inp, so every block stays
+    // valid from any starting state.
+    void fold()
+    {
+        std::vector<Instruction> res;
+        std::array<std::optional<int64_t>, 4> known = {0, 0, 0, 0};
+        for (auto ins : code_)
+        {
+            if (ins.op == Op::inp)
+            {
+                known = {};
+                res.push_back(ins);
+                continue;
+            }
+            const auto &a = known[ins.a];
+            const std::optional<int64_t> b = ins.immediate ? std::optional(ins.b) : known[ins.b];
+            if (b && !ins.immediate)
+            {
+                ins = {ins.op, ins.a, true, *b};
+            }
+
+            const bool no_op = (b == 0 && (ins.op == Op::add)) ||
+                               (b == 1 && (ins.op == Op::mul || ins.op == Op::div)) ||
+                               (a == 0 && (ins.op == Op::mul || ins.op == Op::div || ins.op == Op::mod));
+            if (no_op)
+            {
+                continue;
+            }
+            if (a && b)
+            {
+                Registers regs = {0, 0, 0, 0};
+                regs[ins.a] = *a;
+                execute_one(ins, regs);
+                ins = {Op::set, ins.a, true, regs[ins.a]};
+            }
+            else if (b == 0 && ins.op == Op::mul)
+            {
+                ins = {Op::set, ins.a, true, 0};
+            }
+            else if (a == 0 && ins.op == Op::add)
+            {
+                ins.op = ins.immediate ? Op::set : Op::cpy;
+            }
+
+            if (ins.op == Op::set)
+            {
+                known[ins.a] = ins.b;
+            }
+            else if (ins.op == Op::cpy)
+            {
+                known[ins.a] = known[ins.b];
+            }
+            else
+            {
+                known[ins.a].reset();
+            }
+            res.push_back(ins);
+        }
+        code_ = std::move(res);
+    }
+
+    static void execute_one(const Instruction &ins, Registers &regs)
+    {
+        const int64_t b = ins.immediate ? ins.b : regs[ins.b];
+        auto &a = regs[ins.a];
+        switch (ins.op)
+        {
+        case Op::add:
+            a += b;
+            break;
+        case Op::mul:
+            a *= b;
+            break;
+        case Op::div:
+            a = alu_div(a, b);
+            break;
+        case Op::mod:
+            a = alu_mod(a, b);
+            break;
+        case Op::eql:
+            a = a == b;
+            break;
+        default:
+            a = b;
+            break;
+        }
+    }
+
+    void split_blocks()
+    {
+        for (uint64_t i = 0; i < code_.size(); i++)
+        {
+            if (code_[i].op == Op::inp)
+            {
+                if (!blocks_.empty())
                 {
-                    tmp_prev_z.emplace(nz, val);
+                    blocks_.back().last = i;
                 }
+                blocks_.push_back({i, code_.size(), false, std::nullopt});
+            }
+        }
+        for (auto &block : blocks_)
+        {
+            block.z_only = reads_only_z(block);
+            if (block.z_only)
+            {
+                block.step = derive(block);
+            }
+        }
+    }
+
+    bool reads_only_z(const Block &block) const
+    {
+        std::array<bool, 4> written = {false, false, false, true};
+        for (uint64_t i = block.first; i < block.last; i++)
+        {
+            const auto &ins = code_[i];
+            const bool reads_a = ins.op != Op::inp && ins.op != Op::set && ins.op != Op::cpy;
+            if ((reads_a && !written[ins.a]) || (!ins.immediate && !written[ins.b]))
+            {
+                return false;
             }
+            written[ins.a] = true;
         }
-        prev_z = tmp_prev_z;
+        return true;
     }
-    return prev_z.at(0);
+
+    // Evaluates a z-only block symbolically and matches its result against
+    // the MONAD step
+    //   x = (z % 26 + a == w) == 0
+    //   z' = z / d * (25 * x + 1) + (w + b) * x
+    // up to the order of operands of add and mul. Folding drops a divisor
+    // of 1 and offsets of 0, so those are accepted as missing. The match is
+    // exact, so z_func agrees with the block for every z.
+    std::optional<Var> derive(const Block &block) const
+    {
+        typedef Expression E;
+        std::vector<E> nodes;
+        const auto make = [&nodes](E::Kind kind, int64_t value = 0, uint32_t lhs = 0, uint32_t rhs = 0)
+        {
+            nodes.push_back({kind, value, lhs, rhs});
+            return static_cast<uint32_t>(nodes.size() - 1);
+        };
+        const auto constant = [&nodes](uint32_t n) -> std::optional<int64_t>
+        {
+            return nodes[n].kind == E::constant ? std::optional(nodes[n].value) : std::nullopt;
+        };
+        const auto fold = [&](E::Kind kind, uint32_t lhs, uint32_t rhs)
+        {
+            const auto a = constant(lhs);
+            const auto b = constant(rhs);
+            if (a && b)
+            {
+                Registers regs = {*a, 0, 0, 0};
+                static constexpr std::array ops = {Op::add, Op::mul, Op::div, Op::mod, Op::eql};
+                execute_one({ops[kind - E::add], 0, true, *b}, regs);
+                return make(E::constant, regs[0]);
+            }
+            if ((kind == E::add && b == 0) || ((kind == E::mul || kind == E::div) && b == 1) ||
+                ((kind == E::mul || kind == E::div || kind == E::mod) && a == 0))
+            {
+                return lhs;
+            }
+            if ((kind == E::add && a == 0) || (kind == E::mul && a == 1) || (kind == E::mul && b == 0))
+            {
+                return rhs;
+            }
+            return make(kind, 0, lhs, rhs);
+        };
+
+        static constexpr std::array kinds = {E::w, E::add, E::mul, E::div, E::mod, E::eql};
+        std::array<uint32_t, 4> regs;
+        regs.fill(make(E::constant));
+        regs[3] = make(E::z);
+        for (uint64_t i = block.first; i < block.last; i++)
+        {
+            const auto &ins = code_[i];
+            const auto b = ins.immediate ? make(E::constant, ins.b) : regs[ins.b];
+            if (ins.op == Op::inp)
+            {
+                regs[ins.a] = make(E::w);
+            }
+            else if (ins.op == Op::set || ins.op == Op::cpy)
+            {
+                regs[ins.a] = b;
+            }
+            else
+            {
+                regs[ins.a] = fold(kinds[static_cast<uint64_t>(ins.op)], regs[ins.a], b);
+            }
+        }
+
+        // Calls match(lhs, rhs) with the operands of a node of the given
+        // kind, in both orders for add and mul.
+        const auto operands = [&nodes](uint32_t n, E::Kind kind, const auto &match)
+        {
+            const auto &node = nodes[n];
+            if (node.kind != kind)
+            {
+                return false;
+            }
+            return match(node.lhs, node.rhs) || ((kind == E::add || kind == E::mul) && match(node.rhs, node.lhs));
+        };
+        const auto is = [&nodes](uint32_t n, E::Kind kind, int64_t value = 0)
+        {
+            return nodes[n].kind == kind && (kind != E::constant || nodes[n].value == value);
+        };
+        // n is inner + c, or just inner with c = 0.
+        const auto offset = [&](uint32_t n, const auto &inner, int64_t &c)
+        {
+            c = 0;
+            return inner(n) || operands(n, E::add, [&](uint32_t lhs, uint32_t rhs)
+                                        { return inner(lhs) && constant(rhs) && (c = *constant(rhs), true); });
+        };
+
+        Var res = {1, 0, 0};
+        int64_t check_offset = 0;
+        const auto is_check = [&](uint32_t n)
+        {
+            int64_t a = 0;
+            const bool found = operands(n, E::eql, [&](uint32_t lhs, uint32_t rhs)
+                                        { return is(rhs, E::constant, 0) &&
+                                                 operands(lhs, E::eql, [&](uint32_t sum, uint32_t digit)
+                                                          { return is(digit, E::w) &&
+                                                                   offset(sum, [&](uint32_t m)
+                                                                          { return operands(m, E::mod, [&](uint32_t v, uint32_t m26)
+                                                                                            { return is(v, E::z) && is(m26, E::constant, 26); }); },
+                                                                          a); }); });
+            check_offset = a;
+            return found;
+        };
+        const auto is_divided = [&](uint32_t n)
+        {
+            res.var1 = 1;
+            return is(n, E::z) || operands(n, E::div, [&](uint32_t v, uint32_t d)
+                                           { return is(v, E::z) && constant(d) && *constant(d) > 0 && (res.var1 = *constant(d), true); });
+        };
+        const auto is_scale = [&](uint32_t n)
+        {
+            int64_t one = 0;
+            return offset(n, [&](uint32_t m)
+                          { return operands(m, E::mul, [&](uint32_t c25, uint32_t x)
+                                            { return is(c25, E::constant, 25) && is_check(x) && (res.var2 = check_offset, true); }); },
+                          one) &&
+                   one == 1;
+        };
+        const auto is_push = [&](uint32_t n)
+        {
+            return operands(n, E::mul, [&](uint32_t digit, uint32_t x)
+                            { return offset(digit, [&](uint32_t m)
+                                            { return is(m, E::w); },
+                                            res.var3) &&
+                                     is_check(x) && check_offset == res.var2; });
+        };
+        const bool matched = operands(regs[3], E::add, [&](uint32_t kept, uint32_t pushed)
+                                      { return operands(kept, E::mul, [&](uint32_t divided, uint32_t scale)
+                                                        { return is_divided(divided) && is_scale(scale); }) &&
+                                               is_push(pushed); });
+        return matched ? std::optional(res) : std::nullopt;
+    }
+
+    std::vector<Instruction> code_;
+    std::vector<Block> blocks_;
+};
+
+// The smallest and largest digit strings reaching each z, so a single pass
+// answers both parts.
+struct ModelRange
+{
+    int64_t min;
+    int64_t max;
+};
+
+// Open addressing from z to ModelRange. clear() keeps the capacity, so two
+// tables swapped per block stop allocating once they have grown.
+class ZTable
+{
+public:
+    static constexpr int64_t empty = std::numeric_limits<int64_t>::min();
+
+    ZTable(uint64_t capacity = 1 << 10)
+        : keys_(capacity, empty),
+          ranges_(capacity)
+    {
+    }
+
+    void insert(int64_t z, int64_t model_number)
+    {
+        if ((size_ + 1) * 2 > keys_.size())
+        {
+            grow();
+        }
+        const auto slot = find(z);
+        if (keys_[slot] == empty)
+        {
+            keys_[slot] = z;
+            ranges_[slot] = {model_number, model_number};
+            size_++;
+            return;
+        }
+        auto &range = ranges_[slot];
+        range = {std::min(range.min, model_number), std::max(range.max, model_number)};
+    }
+
+    std::optional<ModelRange> at(int64_t z) const
+    {
+        const auto slot = find(z);
+        return keys_[slot] == empty ? std::nullopt : std::optional(ranges_[slot]);
+    }
+
+    template <typename Visitor>
+    void for_each(Visitor &&visitor) const
+    {
+        for (uint64_t i = 0; i < keys_.size(); i++)
+        {
+            if (keys_[i] != empty)
+            {
+                visitor(keys_[i], ranges_[i]);
+            }
+        }
+    }
+
+    void clear()
+    {
+        if (size_ > 0)
+        {
+            ranges::fill(keys_, empty);
+            size_ = 0;
+        }
+    }
+
+    uint64_t size() const
+    {
+        return size_;
+    }
+
+private:
+    uint64_t find(int64_t z) const
+    {
+        const uint64_t mask = keys_.size() - 1;
+        uint64_t slot = (static_cast<uint64_t>(z) * 0x9e3779b97f4a7c15ul) >> 20;
+        for (slot &= mask; keys_[slot] != empty && keys_[slot] != z; slot = (slot + 1) & mask)
+        {
+        }
+        return slot;
+    }
+
+    void grow()
+    {
+        auto keys = std::move(keys_);
+        auto values = std::move(ranges_);
+        keys_.assign(keys.size() * 2, empty);
+        ranges_.resize(keys_.size());
+        for (uint64_t i = 0; i < keys.size(); i++)
+        {
+            if (keys[i] != empty)
+            {
+                const auto slot = find(keys[i]);
+                keys_[slot] = keys[i];
+                ranges_[slot] = values[i];
+            }
+        }
+    }
+
+    uint64_t size_ = 0;
+    std::vector<int64_t> keys_;
+    std::vector<ModelRange> ranges_;
+};
+
+struct SearchResult
+{
+    std::optional<ModelRange> valid;
+    uint64_t peak_states;
+};
+
+// A z after block i can only reach 0 if it is below the product of the
+// divisors of the blocks still to come: a step never leaves z below
+// z / divisor as long as its offset keeps w + offset non-negative. Blocks
+// that were not recognized, or that could shrink z further, lift the bound.
+std::vector<int64_t> z_bounds(const Alu &alu)
+{
+    constexpr int64_t unbounded = std::numeric_limits<int64_t>::max();
+    const auto &blocks = alu.blocks();
+    std::vector<int64_t> res(blocks.size() + 1, 1);
+    for (uint64_t i = blocks.size(); i-- > 0;)
+    {
+        const auto &step = blocks[i].step;
+        if (!step || step->var1 < 1 || step->var3 < -1 || res[i + 1] > unbounded / step->var1)
+        {
+            res[i] = unbounded;
+        }
+        else
+        {
+            res[i] = res[i + 1] * step->var1;
+        }
+    }
+    return res;
+}
+
+// Every block must be a function of z and its digit alone; a block that
+// reads x, y or w left over from the one before cannot be searched over z.
+SearchResult search(const Alu &alu)
+{
+    if (!ranges::all_of(alu.blocks(), &Block::z_only))
+    {
+        throw std::runtime_error("block reads registers other than z from the previous block");
+    }
+    const auto bounds = z_bounds(alu);
+    ZTable current;
+    ZTable next;
+    current.insert(alu.run_prefix()[3], 0);
+    uint64_t peak_states = 1;
+
+    for (uint64_t i = 0; const auto &block : alu.blocks())
+    {
+        const auto bound = bounds[++i];
+        current.for_each([&](int64_t z, const ModelRange &range)
+                         {
+                             for (int64_t w = 1; w < 10; w++)
+                             {
+                                 const auto nz = block.step ? z_func(z, w, *block.step) : alu.run_block(block, z, w);
+                                 if (nz < bound)
+                                 {
+                                     next.insert(nz, range.min * 10 + w);
+                                     next.insert(nz, range.max * 10 + w);
+                                 }
+                             } });
+        std::swap(current, next);
+        next.clear();
+        peak_states = std::max(peak_states, current.size());
+    }
+    return {current.at(0), peak_states};
+}
+
+ModelRange solve(const std::vector<std::string> &lines)
+{
+    const auto valid = search(Alu(lines)).valid;
+    if (!valid)
+    {
+        throw std::runtime_error("no valid model number");
+    }
+    return *valid;
+}
+
+std::vector<int64_t> digits(int64_t model_number)
+{
+    std::vector<int64_t> res;
+    for (; model_number > 0; model_number /= 10)
+    {
+        res.push_back(model_number % 10);
+    }
+    ranges::reverse(res);
+    return res;
 }
 
 int main()
 {
     const aoc::StopWatch stop_watch;
+    {
+        const Alu negate({"inp x", "mul x -1"});
+        const int64_t seven = 7;
+        aoc::assert_equal(negate.run(&seven)[1], -7l);
+
+        const Alu binary({"inp w", "add z w", "mod z 2", "div w 2", "add y w", "mod y 2",
+                          "div w 2", "add x w", "mod x 2", "div w 2", "mod w 2"});
+        const int64_t eleven = 11;
+        const auto regs = binary.run(&eleven);
+        aoc::assert_equal(regs[0] * 8 + regs[1] * 4 + regs[2] * 2 + regs[3], 11l);
+    }
     const auto lines = aoc::get_lines("input.txt");
-    aoc::assert_equal(solve(lines, std::less<int64_t>()), 49917929934999l); // part 1
-    aoc::assert_equal(solve(lines, std::greater<int64_t>()), 11911316711816l); // part 2
+    {
+        const Alu by_zero({"inp x", "div x 0", "inp y", "mod y 0", "inp z", "add z 1", "div z y"});
+        const std::array<int64_t, 3> input = {5, 6, 7};
+        aoc::assert_equal(by_zero.run(input.data()) == Registers{0, 0, 0, 0}, true);
+        int64_t z = -1;
+        by_zero.run_batch(input.data(), 1, &z);
+        aoc::assert_equal(z, 0l);
+
+        // The same as the first block for z below 1e9 only.
+        std::vector<std::string> skewed(lines.begin(), lines.begin() + 18);
+        const auto plain = *Alu(skewed).blocks()[0].step;
+        skewed.insert(skewed.end(), {"mul x 0", "add x z", "div x 1000000000", "add z x"});
+        const Alu skewed_alu(skewed);
+        const auto &block = skewed_alu.blocks()[0];
+        aoc::assert_equal(block.z_only && !block.step, true);
+        aoc::assert_equal(skewed_alu.run_block(block, 5000, 3), z_func(5000, 3, plain));
+        aoc::assert_equal(skewed_alu.run_block(block, 5000000000, 3) != z_func(5000000000, 3, plain), true);
+    }
+    {
+        const std::vector<std::string> prefixed = {"add z 3", "inp w", "add z w", "add z -5"};
+        const auto valid = search(Alu(prefixed)).valid;
+        aoc::assert_equal(valid->min, 2l);
+        aoc::assert_equal(valid->max, 2l);
+    }
+    {
+        const std::vector<std::string> never_zero = {"inp w", "add z w", "inp w", "mul z w"};
+        aoc::assert_equal(search(Alu(never_zero)).valid.has_value(), false);
+        bool thrown = false;
+        try
+        {
+            solve(never_zero);
+        }
+        catch (const std::runtime_error &error)
+        {
+            thrown = error.what() == std::string("no valid model number");
+        }
+        aoc::assert_equal(thrown, true);
+
+        const std::vector<std::string> carried = {"inp w", "add x w", "inp w", "add z x"};
+        aoc::assert_equal(Alu(carried).blocks()[1].z_only, false);
+        thrown = false;
+        try
+        {
+            search(Alu(carried));
+        }
+        catch (const std::runtime_error &)
+        {
+            thrown = true;
+        }
+        aoc::assert_equal(thrown, true);
+    }
+    {
+        const Alu alu(lines);
+        aoc::assert_equal(alu.input_count(), 14ul);
+        aoc::assert_equal(alu.size() < lines.size(), true);
+        aoc::assert_equal(ranges::all_of(alu.blocks(), [](const auto &block)
+                                         { return block.step.has_value(); }),
+                          true);
+        aoc::assert_equal(alu.run(digits(49917929934999l).data())[3], 0l);
+        aoc::assert_equal(alu.run(digits(11911316711816l).data())[3], 0l);
+        aoc::assert_equal(alu.run(digits(11911316711817l).data())[3] != 0, true);
+
+        uint64_t seed = 24;
+        constexpr uint64_t count = 1000000;
+        std::vector<int64_t> inputs(count * alu.input_count());
+        for (auto &digit : inputs)
+        {
+            seed = seed * 6364136223846793005ul + 1442695040888963407ul;
+            digit = 1 + (seed >> 33) % 9;
+        }
+        std::vector<int64_t> scalar(count);
+        std::vector<int64_t> batched(count);
+        {
+            const aoc::StopWatch watch;
+            for (uint64_t i = 0; i < count; i++)
+            {
+                scalar[i] = alu.run(&inputs[i * alu.input_count()])[3];
+            }
+            aoc::print("1e6 model numbers, one at a time");
+        }
+        {
+            const aoc::StopWatch watch;
+            alu.run_batch(inputs.data(), count, batched.data());
+            aoc::print("1e6 model numbers, ", Alu::lanes, " lanes");
+        }
+        aoc::assert_equal(scalar == batched, true);
+    }
+    const auto valid = solve(lines);
+    aoc::assert_equal(valid.max, 49917929934999l); // part 1
+    aoc::assert_equal(valid.min, 11911316711816l); // part 2
+    {
+        const aoc::StopWatch watch;
+        const auto result = search(Alu(lines));
+        aoc::assert_equal(result.valid->max, valid.max);
+        aoc::print("pruned search, peak z states: ", result.peak_states);
+    }
 
     return 0;
 }
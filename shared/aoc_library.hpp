@@ -40,7 +40,7 @@ namespace aoc
 
     inline std::vector<std::string> split(const std::string &in, const std::string &delim = " ")
     {
-        const auto split = ranges::views::split(in, delim) |
+        auto split = ranges::views::split(in, delim) |
                            ranges::views::transform([](const auto &part)
                                                     {
                                                         const auto c = part | ranges::views::common;